@@ -0,0 +1,293 @@
+#include "bytecode.h"
+#include <core/common.h>
+#include <core/buffer.h>
+#include <core/file.h>
+#include <core/memory.h>
+#include <compiler/compiler.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A cache file is a header followed by the script's function. Functions are written depth first, their
+// nested functions inline among their constants. Numbers are in the machine's own byte order, as caches
+// are not meant to be moved between machines.
+typedef struct {
+	char magic[4];
+	uint32_t version;
+	uint64_t sourceHash;
+	uint64_t sourceLength;
+	uint64_t bodyHash; // Catches a cache which was cut short or damaged after it was written.
+} BytecodeHeader;
+
+#define BYTECODE_MAGIC "FOXC"
+
+#define NO_NAME UINT32_MAX
+
+typedef enum {
+	CONSTANT_NULL,
+	CONSTANT_FALSE,
+	CONSTANT_TRUE,
+	CONSTANT_NUMBER,
+	CONSTANT_STRING,
+	CONSTANT_FUNCTION
+} ConstantTag;
+
+static const char* cacheSetting = NULL;
+static bool isCacheSet = false;
+
+bool setBytecodeCache(const char* setting) {
+	if (*setting == '\0') return false;
+	cacheSetting = setting;
+	isCacheSet = true;
+	return true;
+}
+
+static const char* bytecodeCache() {
+	if (!isCacheSet) {
+		isCacheSet = true;
+		char* setting = getenv("FOX_CACHE");
+		if (setting != NULL && *setting != '\0') cacheSetting = setting;
+	}
+	return cacheSetting;
+}
+
+// Beside the source, x.fox is cached as x.foxc. In a cache directory files are named by a hash of their
+// canonical path, so that files with the same name do not share a cache.
+static char* cachePathFor(const char* path) {
+	const char* setting = bytecodeCache();
+	if (setting != NULL && strcmp(setting, "off") == 0) return NULL;
+
+	if (setting == NULL) {
+		size_t length = strlen(path);
+		bool isFox = length >= 4 && strcmp(path + length - 4, ".fox") == 0;
+		char* cachePath = malloc(length + 6);
+		memcpy(cachePath, path, length);
+		strcpy(cachePath + length, isFox ? "c" : ".foxc");
+		return cachePath;
+	}
+
+	char* canonical = canonicalPath(path);
+	if (canonical == NULL) return NULL;
+	uint64_t hash = hashBytes(canonical, strlen(canonical));
+	free(canonical);
+
+	size_t length = snprintf(NULL, 0, "%s/%016llx.foxc", setting, (unsigned long long)hash);
+	char* cachePath = malloc(length + 1);
+	sprintf(cachePath, "%s/%016llx.foxc", setting, (unsigned long long)hash);
+	return cachePath;
+}
+
+static void writeString(Buffer* buffer, ObjString* string) {
+	if (string == NULL) {
+		bufferWriteU32(buffer, NO_NAME);
+		return;
+	}
+	bufferWriteU32(buffer, (uint32_t)string->length);
+	bufferWrite(buffer, string->chars, string->length);
+}
+
+static void writeFunction(Buffer* buffer, ObjFunction* function) {
+	bufferWriteU8(buffer, (function->lambda ? 1 : 0) | (function->varArgs ? 2 : 0));
+	bufferWriteU32(buffer, (uint32_t)function->arity);
+	bufferWriteU32(buffer, (uint32_t)function->upvalueCount);
+	writeString(buffer, function->name);
+
+	Chunk* chunk = &function->chunk;
+	bufferWriteU32(buffer, (uint32_t)chunk->count);
+	bufferWrite(buffer, (const char*)chunk->code, chunk->count);
+
+	bufferWriteU32(buffer, (uint32_t)chunk->table.count);
+	for (size_t i = 0; i < chunk->table.count; i++) bufferWriteU64(buffer, chunk->table.lines[i]);
+
+	bufferWriteU32(buffer, (uint32_t)chunk->constants.count);
+	for (size_t i = 0; i < chunk->constants.count; i++) {
+		Value constant = chunk->constants.values[i];
+
+		if (IS_NULL(constant)) bufferWriteU8(buffer, CONSTANT_NULL);
+		else if (IS_BOOL(constant)) bufferWriteU8(buffer, AS_BOOL(constant) ? CONSTANT_TRUE : CONSTANT_FALSE);
+		else if (IS_NUMBER(constant)) {
+			double number = AS_NUMBER(constant);
+			uint64_t bits;
+			memcpy(&bits, &number, sizeof(bits));
+			bufferWriteU8(buffer, CONSTANT_NUMBER);
+			bufferWriteU64(buffer, bits);
+		}
+		else if (IS_STRING(constant)) {
+			bufferWriteU8(buffer, CONSTANT_STRING);
+			writeString(buffer, AS_STRING(constant));
+		}
+		else {
+			bufferWriteU8(buffer, CONSTANT_FUNCTION);
+			writeFunction(buffer, AS_FUNCTION(constant));
+		}
+	}
+}
+
+// Writes to a temporary file first, so that a run loading the cache never sees it half written.
+static void writeCache(const char* cachePath, ObjFunction* function, uint64_t sourceHash, size_t sourceLength) {
+	Buffer buffer;
+	initBuffer(&buffer);
+
+	BytecodeHeader header;
+	memcpy(header.magic, BYTECODE_MAGIC, sizeof(header.magic));
+	header.version = BYTECODE_VERSION;
+	header.sourceHash = sourceHash;
+	header.sourceLength = sourceLength;
+	header.bodyHash = 0;
+	bufferWrite(&buffer, (const char*)&header, sizeof(header));
+
+	writeFunction(&buffer, function);
+
+	header.bodyHash = hashBytes(buffer.chars + sizeof(header), buffer.length - sizeof(header));
+	memcpy(buffer.chars, &header, sizeof(header));
+
+	size_t pathLength = strlen(cachePath);
+	char* tempPath = malloc(pathLength + 5);
+	memcpy(tempPath, cachePath, pathLength);
+	strcpy(tempPath + pathLength, ".tmp");
+
+	FILE* file = fopen(tempPath, "wb");
+	if (file != NULL) {
+		bool isWritten = fwrite(buffer.chars, 1, buffer.length, file) == buffer.length;
+		isWritten = fclose(file) == 0 && isWritten;
+
+#if defined(_WIN32) || defined(_WIN64) || defined(WINDOWS)
+		remove(cachePath); // Windows will not rename over an existing file.
+#endif
+		if (!isWritten || rename(tempPath, cachePath) != 0) remove(tempPath);
+	}
+
+	free(tempPath);
+	freeBuffer(&buffer);
+}
+
+static ObjString* readString(VM* vm, Reader* reader) {
+	uint32_t length = readU32(reader);
+	if (length == NO_NAME) return NULL;
+
+	const uint8_t* chars = readBytes(reader, length);
+	if (chars == NULL) return NULL;
+	return copyString(vm, (const char*)chars, length);
+}
+
+// The function is kept on the stack while it is filled in, and the functions nested in it are rooted by
+// its constants, so none of them can be collected before the whole tree is read.
+static ObjFunction* readFunction(VM* vm, Reader* reader) {
+	ObjFunction* function = newFunction(vm);
+	push(vm, OBJ_VAL(function));
+
+	uint8_t flags = readU8(reader);
+	function->lambda = (flags & 1) != 0;
+	function->varArgs = (flags & 2) != 0;
+	function->arity = readU32(reader);
+	function->upvalueCount = readU32(reader);
+	function->name = readString(vm, reader);
+	if (function->name != NULL) writeBarrier(vm, &function->obj, OBJ_VAL(function->name));
+
+	Chunk* chunk = &function->chunk;
+	size_t codeCount = readU32(reader);
+	const uint8_t* code = readBytes(reader, codeCount);
+	if (code != NULL && codeCount > 0) {
+		chunk->code = ALLOCATE(vm, uint8_t, codeCount);
+		memcpy(chunk->code, code, codeCount);
+		chunk->count = codeCount;
+		chunk->capacity = codeCount;
+	}
+
+	size_t lineCount = readU32(reader);
+	if (!reader->isError && lineCount > 0 && lineCount <= (reader->length - reader->offset) / sizeof(uint64_t)) {
+		chunk->table.lines = ALLOCATE(vm, size_t, lineCount);
+		chunk->table.capacity = lineCount;
+		for (size_t i = 0; i < lineCount; i++) chunk->table.lines[i] = (size_t)readU64(reader);
+		chunk->table.count = lineCount;
+	}
+	else if (lineCount > 0) {
+		reader->isError = true;
+	}
+
+	size_t constantCount = readU32(reader);
+	for (size_t i = 0; i < constantCount && !reader->isError; i++) {
+		Value constant = NULL_VAL;
+
+		switch (readU8(reader)) {
+			case CONSTANT_NULL: break;
+			case CONSTANT_FALSE: constant = BOOL_VAL(false); break;
+			case CONSTANT_TRUE: constant = BOOL_VAL(true); break;
+			case CONSTANT_NUMBER: {
+				uint64_t bits = readU64(reader);
+				double number;
+				memcpy(&number, &bits, sizeof(number));
+				constant = NUMBER_VAL(number);
+				break;
+			}
+			case CONSTANT_STRING: {
+				ObjString* string = readString(vm, reader);
+				if (string == NULL) reader->isError = true;
+				else constant = OBJ_VAL(string);
+				break;
+			}
+			case CONSTANT_FUNCTION: {
+				ObjFunction* nested = readFunction(vm, reader);
+				if (nested != NULL) constant = OBJ_VAL(nested);
+				break;
+			}
+			default: reader->isError = true; break;
+		}
+
+		if (!reader->isError) addConstant(vm, chunk, constant);
+	}
+
+	pop(vm);
+	return reader->isError ? NULL : function;
+}
+
+static ObjFunction* loadCache(VM* vm, const char* cachePath, uint64_t sourceHash, size_t sourceLength) {
+	File file = readFile(cachePath);
+	if (file.isError) {
+		free(file.contents);
+		return NULL;
+	}
+
+	ObjFunction* function = NULL;
+
+	BytecodeHeader header;
+	if (file.length >= sizeof(header)) {
+		memcpy(&header, file.contents, sizeof(header));
+
+		const uint8_t* body = (const uint8_t*)file.contents + sizeof(header);
+		size_t bodyLength = file.length - sizeof(header);
+
+		if (memcmp(header.magic, BYTECODE_MAGIC, sizeof(header.magic)) == 0 && header.version == BYTECODE_VERSION
+			&& header.sourceHash == sourceHash && header.sourceLength == sourceLength
+			&& header.bodyHash == hashBytes(body, bodyLength)) {
+			Reader reader;
+			initReader(&reader, body, bodyLength);
+			function = readFunction(vm, &reader);
+			if (reader.offset != reader.length) function = NULL;
+		}
+	}
+
+	free(file.contents);
+	return function;
+}
+
+ObjFunction* compileFile(VM* vm, const char* path, const char* source, size_t length) {
+	char* cachePath = cachePathFor(path);
+	uint64_t sourceHash = hashBytes(source, length);
+
+	ObjFunction* function = NULL;
+	if (cachePath != NULL) function = loadCache(vm, cachePath, sourceHash, length);
+
+	if (function == NULL) {
+		Chunk chunk;
+		initChunk(&chunk);
+		function = compile(vm, source, &chunk);
+		vm->compiler = NULL;
+
+		// Writing allocates nothing from the heap, so the function needs no rooting meanwhile.
+		if (function != NULL && cachePath != NULL) writeCache(cachePath, function, sourceHash, length);
+	}
+
+	free(cachePath);
+	return function;
+}
\ No newline at end of file
@@ -0,0 +1,15 @@
+#pragma once
+#include <core/common.h>
+#include <vm/vm.h>
+
+// Compiled files are cached as .foxc files, which only this version of the format will load. Bump it
+// whenever the compiler's output or the format changes.
+#define BYTECODE_VERSION 1
+
+// Compiles source, the contents of the file at path, or loads the function cached for it by an earlier
+// run when that was compiled from the same source. Returns NULL if the source does not compile.
+ObjFunction* compileFile(VM* vm, const char* path, const char* source, size_t length);
+
+// Sets where compiled files are cached, from FOX_CACHE or --cache. "off" disables the cache, anything
+// else names an existing directory to keep it in. By default each file is cached beside its source.
+bool setBytecodeCache(const char* setting);
\ No newline at end of file
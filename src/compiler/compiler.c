@@ -141,6 +141,7 @@ static void initCompiler(Compiler* compiler, Compiler* oldCompiler, VM* vm, Pars
 
 	if (type != TYPE_SCRIPT) {
 		compiler->function->name = copyString(vm, parser->previous.start, parser->previous.length);
+		writeBarrier(vm, &compiler->function->obj, OBJ_VAL(compiler->function->name));
 	}
 
 	Local* local = &compiler->locals[compiler->localCount++];
@@ -215,6 +216,7 @@ static ObjFunction* endCompiler(Parser* parser, Compiler* compiler) {
 		disassembleChunk(compiler->vm, currentChunk(compiler), function->name != NULL ? function->name->chars : "<script>");
 	}
 #endif
+	compiler->vm->compiler = compiler->enclosing; // Stop rooting through this compiler once it goes out of scope.
 	return function;
 }
 
@@ -287,8 +289,10 @@ static void emitConstant(Parser* parser, Compiler* compiler, Value value) {
 		}
 	}
 
+	// Add the constant first, emitting can collect while the value is not yet rooted by the chunk.
+	uint8_t constant = makeConstant(parser, compiler, value);
 	emitByte(parser, compiler, OP_CONSTANT);
-	emitByte(parser, compiler, makeConstant(parser, compiler, value));
+	emitByte(parser, compiler, constant);
 }
 
 static bool isAssignment(Parser* parser) {
@@ -434,7 +438,9 @@ static void literal(Parser* parser, Compiler* compiler, bool canAssign, bool can
 	}
 }
 
-static void replaceEscapes(char at[], char bt[]) {
+// Returns the length of the unescaped string.
+static size_t replaceEscapes(char at[], char bt[]) {
+	char* start = at;
 	for (int j = 0; bt[j]; j++) {
 		if (bt[j] == '\\') {
 			j++;
@@ -476,6 +482,7 @@ static void replaceEscapes(char at[], char bt[]) {
 		*at++ = bt[j];
 	}
 	*at = '\0';
+	return (size_t)(at - start);
 }
 
 static void string(Parser* parser, Compiler* compiler, bool canAssign, bool canDestructure) {
@@ -488,9 +495,9 @@ static void string(Parser* parser, Compiler* compiler, bool canAssign, bool canD
 	memcpy(nullString, parser->previous.start + 1, parser->previous.length - 2);
 	nullString[parser->previous.length - 2] = '\0';
 
-	replaceEscapes(dest, nullString);
+	size_t length = replaceEscapes(dest, nullString);
 
-	emitConstant(parser, compiler, OBJ_VAL(copyString(parser->vm, dest, parser->previous.length - 2)));
+	emitConstant(parser, compiler, OBJ_VAL(copyString(parser->vm, dest, length)));
 
 	free(dest);
 	free(nullString);
@@ -580,6 +587,7 @@ static void lambda(Parser* parser, Compiler* c, bool canAssign, bool canDestruct
 	beginScope(&compiler);
 
 	compiler.function->name = copyString(parser->vm, "<lambda>", 8);
+	writeBarrier(parser->vm, &compiler.function->obj, OBJ_VAL(compiler.function->name));
 	compiler.function->lambda = true;
 
 	bool varArgs = false;
@@ -617,8 +625,9 @@ static void lambda(Parser* parser, Compiler* c, bool canAssign, bool canDestruct
 
 	// Create the function object.
 	ObjFunction* function = endCompiler(parser, &compiler);
+	uint8_t constant = makeConstant(parser, c, OBJ_VAL(function)); // Roots the function before emitting can collect.
 	emitByte(parser, c, OP_CLOSURE);
-	emitByte(parser, c, makeConstant(parser, c, OBJ_VAL(function)));
+	emitByte(parser, c, constant);
 
 	for (size_t i = 0; i < function->upvalueCount; i++) {
 		emitByte(parser, c, compiler.upvalues[i].isLocal ? 1 : 0);
@@ -632,6 +641,7 @@ static void lambdaOr(Parser* parser, Compiler* c, bool canAssign, bool canDestru
 	beginScope(&compiler);
 
 	compiler.function->name = copyString(parser->vm, "<lambda>", 8);
+	writeBarrier(parser->vm, &compiler.function->obj, OBJ_VAL(compiler.function->name));
 	compiler.function->lambda = true;
 
 	// The body.
@@ -647,8 +657,9 @@ static void lambdaOr(Parser* parser, Compiler* c, bool canAssign, bool canDestru
 
 	// Create the function object.
 	ObjFunction* function = endCompiler(parser, &compiler);
+	uint8_t constant = makeConstant(parser, c, OBJ_VAL(function)); // Roots the function before emitting can collect.
 	emitByte(parser, c, OP_CLOSURE);
-	emitByte(parser, c, makeConstant(parser, c, OBJ_VAL(function)));
+	emitByte(parser, c, constant);
 
 	for (size_t i = 0; i < function->upvalueCount; i++) {
 		emitByte(parser, c, compiler.upvalues[i].isLocal ? 1 : 0);
@@ -1797,8 +1808,9 @@ static void function(Parser* parser, Compiler* c, FunctionType type) {
 
 	// Create the function object.
 	ObjFunction* function = endCompiler(parser, &compiler);
+	uint8_t constant = makeConstant(parser, c, OBJ_VAL(function)); // Roots the function before emitting can collect.
 	emitByte(parser, c, OP_CLOSURE);
-	emitByte(parser, c, makeConstant(parser, c, OBJ_VAL(function)));
+	emitByte(parser, c, constant);
 
 	for (size_t i = 0; i < function->upvalueCount; i++) {
 		emitByte(parser, c, compiler.upvalues[i].isLocal ? 1 : 0);
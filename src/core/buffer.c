@@ -0,0 +1,155 @@
+#include "buffer.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+void initBuffer(Buffer* buffer) {
+	buffer->chars = NULL;
+	buffer->length = 0;
+	buffer->capacity = 0;
+}
+
+void freeBuffer(Buffer* buffer) {
+	free(buffer->chars);
+	initBuffer(buffer);
+}
+
+// Always leaves room for a NUL terminator after extra more chars.
+void bufferReserve(Buffer* buffer, size_t extra) {
+	size_t needed = buffer->length + extra + 1;
+	if (needed <= buffer->capacity) return;
+
+	size_t capacity = buffer->capacity < 64 ? 64 : buffer->capacity * 2;
+	while (capacity < needed) capacity *= 2;
+
+	char* chars = realloc(buffer->chars, capacity);
+	if (chars == NULL) {
+		fprintf(stderr, "Failed to reallocate memory.");
+		exit(-1);
+	}
+
+	buffer->chars = chars;
+	buffer->capacity = capacity;
+}
+
+void bufferWrite(Buffer* buffer, const char* chars, size_t length) {
+	bufferReserve(buffer, length);
+	memcpy(buffer->chars + buffer->length, chars, length);
+	buffer->length += length;
+}
+
+void bufferWriteString(Buffer* buffer, const char* string) {
+	bufferWrite(buffer, string, strlen(string));
+}
+
+void bufferWriteChar(Buffer* buffer, char c) {
+	bufferReserve(buffer, 1);
+	buffer->chars[buffer->length++] = c;
+}
+
+void bufferWriteFormat(Buffer* buffer, const char* format, ...) {
+	bufferReserve(buffer, 32);
+
+	// Format straight into the spare capacity, and only retry when it was too small.
+	va_list args;
+	va_start(args, format);
+	va_list retryArgs;
+	va_copy(retryArgs, args);
+
+	size_t available = buffer->capacity - buffer->length;
+	int length = vsnprintf(buffer->chars + buffer->length, available, format, args);
+
+	if (length >= 0 && (size_t)length >= available) {
+		bufferReserve(buffer, (size_t)length);
+		vsnprintf(buffer->chars + buffer->length, (size_t)length + 1, format, retryArgs);
+	}
+
+	va_end(retryArgs);
+	va_end(args);
+
+	if (length > 0) buffer->length += (size_t)length;
+}
+
+char* bufferTake(Buffer* buffer) {
+	bufferReserve(buffer, 0);
+	buffer->chars[buffer->length] = '\0';
+
+	char* chars = buffer->chars;
+	initBuffer(buffer);
+	return chars;
+}
+
+void bufferWriteU8(Buffer* buffer, uint8_t value) {
+	bufferWriteChar(buffer, (char)value);
+}
+
+void bufferWriteU32(Buffer* buffer, uint32_t value) {
+	bufferWrite(buffer, (const char*)&value, sizeof(value));
+}
+
+void bufferWriteU64(Buffer* buffer, uint64_t value) {
+	bufferWrite(buffer, (const char*)&value, sizeof(value));
+}
+
+void initReader(Reader* reader, const void* bytes, size_t length) {
+	reader->bytes = bytes;
+	reader->length = length;
+	reader->offset = 0;
+	reader->isError = false;
+}
+
+const uint8_t* readBytes(Reader* reader, size_t length) {
+	if (reader->isError || length > reader->length - reader->offset) {
+		reader->isError = true;
+		return NULL;
+	}
+	const uint8_t* bytes = reader->bytes + reader->offset;
+	reader->offset += length;
+	return bytes;
+}
+
+uint8_t readU8(Reader* reader) {
+	const uint8_t* bytes = readBytes(reader, 1);
+	return bytes == NULL ? 0 : *bytes;
+}
+
+uint32_t readU32(Reader* reader) {
+	uint32_t value = 0;
+	const uint8_t* bytes = readBytes(reader, sizeof(value));
+	if (bytes != NULL) memcpy(&value, bytes, sizeof(value));
+	return value;
+}
+
+uint64_t readU64(Reader* reader) {
+	uint64_t value = 0;
+	const uint8_t* bytes = readBytes(reader, sizeof(value));
+	if (bytes != NULL) memcpy(&value, bytes, sizeof(value));
+	return value;
+}
+
+uint64_t hashBytes(const void* bytes, size_t length) {
+	uint64_t hash = 14695981039346656037u;
+	for (size_t i = 0; i < length; i++) {
+		hash ^= ((const uint8_t*)bytes)[i];
+		hash *= 1099511628211u;
+	}
+	return hash;
+}
+
+static Buffer output = { NULL, 0, 0 };
+
+Buffer* outputBuffer() {
+	return &output;
+}
+
+void outputWritten() {
+	if (output.length >= OUTPUT_BLOCK_SIZE) flushOutput();
+}
+
+void flushOutput() {
+	if (output.length != 0) {
+		fwrite(output.chars, 1, output.length, stdout);
+		output.length = 0;
+	}
+	fflush(stdout);
+}
\ No newline at end of file
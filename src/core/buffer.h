@@ -0,0 +1,66 @@
+#pragma once
+#include <core/common.h>
+#include <stdio.h>
+
+// A growable, malloc backed character buffer which values are formatted into.
+typedef struct {
+	char* chars;
+	size_t length;
+	size_t capacity;
+} Buffer;
+
+void initBuffer(Buffer* buffer);
+
+void freeBuffer(Buffer* buffer);
+
+void bufferReserve(Buffer* buffer, size_t extra);
+
+void bufferWrite(Buffer* buffer, const char* chars, size_t length);
+
+void bufferWriteString(Buffer* buffer, const char* string);
+
+void bufferWriteChar(Buffer* buffer, char c);
+
+void bufferWriteFormat(Buffer* buffer, const char* format, ...);
+
+// Returns the contents as a NUL terminated string owned by the caller, and empties the buffer.
+char* bufferTake(Buffer* buffer);
+
+// Binary data is written in the machine's own byte order, for files only read back on the same machine.
+void bufferWriteU8(Buffer* buffer, uint8_t value);
+
+void bufferWriteU32(Buffer* buffer, uint32_t value);
+
+void bufferWriteU64(Buffer* buffer, uint64_t value);
+
+// Reads back binary data. Reading past the end sets isError, after which every read returns nothing.
+typedef struct {
+	const uint8_t* bytes;
+	size_t length;
+	size_t offset;
+	bool isError;
+} Reader;
+
+void initReader(Reader* reader, const void* bytes, size_t length);
+
+// Returns NULL unless length more bytes remain.
+const uint8_t* readBytes(Reader* reader, size_t length);
+
+uint8_t readU8(Reader* reader);
+
+uint32_t readU32(Reader* reader);
+
+uint64_t readU64(Reader* reader);
+
+//FNV-1a, 64 bit
+uint64_t hashBytes(const void* bytes, size_t length);
+
+// Standard output is written in blocks of this size, or when flushOutput is called.
+#define OUTPUT_BLOCK_SIZE 65536
+
+Buffer* outputBuffer();
+
+// Call after writing to the output buffer, flushes it once a full block is pending.
+void outputWritten();
+
+void flushOutput();
\ No newline at end of file
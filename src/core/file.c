@@ -1,8 +1,13 @@
+// For realpath.
+#define _DEFAULT_SOURCE
 #include "file.h"
 #include <core/common.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#if defined(_WIN32) || defined(_WIN64) || defined(WINDOWS)
+#include <io.h>
+#endif
 
 File readFile(const char* path) {
 	FILE* file = fopen(path, "rb");
@@ -43,7 +48,7 @@ File readFile(const char* path) {
 	}
 
 	fclose(file);
-	return (File) {.contents = buffer, .isError = false};
+	return (File) {.contents = buffer, .length = bytesRead, .isError = false};
 }
 
 char* fromLastInstance(const char* haystack, const char* needle) {
@@ -89,3 +94,21 @@ void changeSeparator(char* string) {
 		}
 	}
 }
+
+
+// The absolute path of an existing file, with links and '.' or '..' parts resolved, so each file has
+// only one. Returns NULL if the file does not exist.
+char* canonicalPath(const char* path) {
+#if defined(_WIN32) || defined(_WIN64) || defined(WINDOWS)
+	char* canonical = _fullpath(NULL, path, 0);
+	if (canonical == NULL || _access(canonical, 0) != 0) {
+		free(canonical);
+		return NULL;
+	}
+#else
+	char* canonical = realpath(path, NULL);
+	if (canonical == NULL) return NULL;
+#endif
+	changeSeparator(canonical);
+	return canonical;
+}
\ No newline at end of file
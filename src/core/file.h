@@ -4,6 +4,7 @@
 
 typedef struct File {
 	char* contents;
+	size_t length; // Of the contents, which are also NUL terminated.
 	bool isError;
 } File;
 
@@ -15,6 +16,9 @@ char* inputString(FILE* fp, size_t size);
 
 void changeSeparator(char* string);
 
+// Returns a malloced path, or NULL if path does not name an existing file.
+char* canonicalPath(const char* path);
+
 #if defined(_WIN32) || defined(_WIN64) || defined(WINDOWS)
 #include <direct.h>
 #define getCurrentDir _getcwd
@@ -0,0 +1,92 @@
+#include "gcStats.h"
+#include <core/common.h>
+#include <string.h>
+
+void initGCStats(GCStats* stats) {
+	memset(stats, 0, sizeof(GCStats));
+}
+
+void recordGCTime(GCStats* stats, GCTimer timer, uint64_t nanos) {
+	GCHistogram* histogram = &stats->times[timer];
+	histogram->count++;
+	histogram->total += nanos;
+	if (nanos > histogram->max) histogram->max = nanos;
+
+	size_t bucket = 0;
+	for (uint64_t micros = nanos / 1000; micros > 0 && bucket < GC_HISTOGRAM_BUCKETS - 1; micros >>= 1) {
+		bucket++;
+	}
+	histogram->buckets[bucket]++;
+}
+
+void recordGCHeap(GCStats* stats, size_t bytes) {
+	stats->heapHistory[stats->heapHistoryCount++ % GC_HEAP_HISTORY] = bytes;
+}
+
+size_t gcHeapHistory(GCStats* stats, size_t* sizes) {
+	size_t count = stats->heapHistoryCount < GC_HEAP_HISTORY ? stats->heapHistoryCount : GC_HEAP_HISTORY;
+	for (size_t i = 0; i < count; i++) {
+		sizes[i] = stats->heapHistory[(stats->heapHistoryCount - count + i) % GC_HEAP_HISTORY];
+	}
+	return count;
+}
+
+const char* gcTimerName(GCTimer timer) {
+	switch (timer) {
+		case GC_TIME_ROOTS: return "roots";
+		case GC_TIME_TRACE: return "trace";
+		case GC_TIME_STRINGS: return "strings";
+		case GC_TIME_SWEEP: return "sweep";
+		case GC_TIME_COMPACT: return "compact";
+		case GC_TIME_PAUSE: return "pause";
+		case GC_TIME_COUNT: break;
+	}
+	return NULL; // Unreachable.
+}
+
+const char* objTypeName(ObjType type) {
+	switch (type) {
+		case OBJ_CLOSURE: return "closure";
+		case OBJ_STRING: return "string";
+		case OBJ_NATIVE: return "native";
+		case OBJ_FUNCTION: return "function";
+		case OBJ_UPVALUE: return "upvalue";
+		case OBJ_CLASS: return "class";
+		case OBJ_INSTANCE: return "instance";
+		case OBJ_BOUND_METHOD: return "boundMethod";
+		case OBJ_LIST: return "list";
+		case OBJ_MAP: return "map";
+		case OBJ_ARRAY: return "array";
+	}
+	return NULL; // Unreachable.
+}
+
+void writeGCStats(GCStats* stats, Buffer* buffer) {
+	bufferWriteFormat(buffer, "{\"fullCycles\":%zu,\"minorCycles\":%zu,\"compactions\":%zu,\"bytesFreed\":%zu,",
+		stats->fullCycles, stats->minorCycles, stats->compactions, stats->bytesFreed);
+
+	bufferWriteString(buffer, "\"objectsFreed\":{");
+	for (int i = 0; i < OBJ_TYPE_COUNT; i++) {
+		bufferWriteFormat(buffer, "%s\"%s\":%zu", i == 0 ? "" : ",", objTypeName((ObjType)i), stats->objectsFreed[i]);
+	}
+
+	bufferWriteString(buffer, "},\"heapHistory\":[");
+	size_t sizes[GC_HEAP_HISTORY];
+	size_t count = gcHeapHistory(stats, sizes);
+	for (size_t i = 0; i < count; i++) {
+		bufferWriteFormat(buffer, "%s%zu", i == 0 ? "" : ",", sizes[i]);
+	}
+
+	bufferWriteString(buffer, "],\"times\":{");
+	for (int i = 0; i < GC_TIME_COUNT; i++) {
+		GCHistogram* histogram = &stats->times[i];
+		bufferWriteFormat(buffer, "%s\"%s\":{\"count\":%zu,\"totalNanos\":%llu,\"maxNanos\":%llu,\"histogram\":[",
+			i == 0 ? "" : ",", gcTimerName((GCTimer)i), histogram->count,
+			(unsigned long long)histogram->total, (unsigned long long)histogram->max);
+		for (int j = 0; j < GC_HISTOGRAM_BUCKETS; j++) {
+			bufferWriteFormat(buffer, "%s%zu", j == 0 ? "" : ",", histogram->buckets[j]);
+		}
+		bufferWriteString(buffer, "]}");
+	}
+	bufferWriteString(buffer, "}}");
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+#pragma once
+#include <core/common.h>
+#include <core/buffer.h>
+#include <vm/object.h>
+#include <stdint.h>
+
+// The parts of a collection which are timed. GC_TIME_PAUSE times each whole pause, which may run
+// several of the others.
+typedef enum {
+	GC_TIME_ROOTS,
+	GC_TIME_TRACE,
+	GC_TIME_STRINGS, // String views and the intern table.
+	GC_TIME_SWEEP,
+	GC_TIME_COMPACT,
+	GC_TIME_PAUSE,
+	GC_TIME_COUNT
+} GCTimer;
+
+// Bucket i counts durations under 2^i microseconds, the last counts everything longer.
+#define GC_HISTOGRAM_BUCKETS 24
+
+typedef struct {
+	size_t count;
+	uint64_t total; // Nanoseconds.
+	uint64_t max;
+	size_t buckets[GC_HISTOGRAM_BUCKETS];
+} GCHistogram;
+
+// Heap sizes kept after the most recent full cycles.
+#define GC_HEAP_HISTORY 64
+
+// Counters kept by the collector, cheap enough to always be on.
+typedef struct {
+	size_t fullCycles;
+	size_t minorCycles;
+	size_t compactions;
+	size_t bytesFreed;
+	size_t objectsFreed[OBJ_TYPE_COUNT];
+	GCHistogram times[GC_TIME_COUNT];
+	size_t heapHistory[GC_HEAP_HISTORY]; // A ring, indexed by heapHistoryCount.
+	size_t heapHistoryCount;
+} GCStats;
+
+void initGCStats(GCStats* stats);
+
+void recordGCTime(GCStats* stats, GCTimer timer, uint64_t nanos);
+
+// Records the heap size left by a full cycle.
+void recordGCHeap(GCStats* stats, size_t bytes);
+
+// The most recent heap sizes recorded, up to GC_HEAP_HISTORY, oldest first.
+size_t gcHeapHistory(GCStats* stats, size_t* sizes);
+
+const char* gcTimerName(GCTimer timer);
+
+const char* objTypeName(ObjType type);
+
+// Writes the stats as a JSON object.
+void writeGCStats(GCStats* stats, Buffer* buffer);
\ No newline at end of file
@@ -0,0 +1,269 @@
+// For MAP_ANONYMOUS.
+#define _DEFAULT_SOURCE
+#include "heap.h"
+#include <core/common.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The page header is padded so cells keep malloc's alignment.
+#define HEAP_PAGE_HEADER ((sizeof(HeapPage) + 15) & ~(size_t)15)
+
+// Regions are mapped directly rather than malloced, so that releasing a page returns it to the system.
+#if defined(_WIN32) || defined(_WIN64) || defined(WINDOWS)
+#include <windows.h>
+
+// Allocations are aligned to Windows' 64K allocation granularity, which HEAP_PAGE_SIZE matches. Large
+// pages need a privilege most processes lack, so hugePages is ignored.
+static char* mapRegion(bool hugePages) {
+	(void)hugePages;
+	return VirtualAlloc(NULL, HEAP_REGION_SIZE, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+}
+
+static void unmapRegion(char* base) {
+	VirtualFree(base, 0, MEM_RELEASE);
+}
+
+static void releasePage(HeapPage* page) {
+	VirtualFree(page, HEAP_PAGE_SIZE, MEM_DECOMMIT);
+}
+
+static bool reusePage(HeapPage* page) {
+	return VirtualAlloc(page, HEAP_PAGE_SIZE, MEM_COMMIT, PAGE_READWRITE) != NULL;
+}
+
+#else
+#include <sys/mman.h>
+
+// Maps twice the region size and trims it down to an aligned region, as huge pages must be aligned.
+static char* mapRegion(bool hugePages) {
+	char* mapping = mmap(NULL, HEAP_REGION_SIZE * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mapping == MAP_FAILED) return NULL;
+
+	char* region = (char*)(((uintptr_t)mapping + HEAP_REGION_SIZE - 1) & ~(uintptr_t)(HEAP_REGION_SIZE - 1));
+	if (region > mapping) munmap(mapping, region - mapping);
+	munmap(region + HEAP_REGION_SIZE, mapping + HEAP_REGION_SIZE - region);
+
+#ifdef MADV_HUGEPAGE
+	// Only a hint, the region is used as normal pages if the system has none to spare.
+	if (hugePages) madvise(region, HEAP_REGION_SIZE, MADV_HUGEPAGE);
+#else
+	(void)hugePages;
+#endif
+
+	return region;
+}
+
+static void unmapRegion(char* base) {
+	munmap(base, HEAP_REGION_SIZE);
+}
+
+// The memory is given back, and reads as zeros if the page is used again.
+static void releasePage(HeapPage* page) {
+	madvise(page, HEAP_PAGE_SIZE, MADV_DONTNEED);
+}
+
+static bool reusePage(HeapPage* page) {
+	(void)page;
+	return true;
+}
+
+#endif
+
+void initHeap(Heap* heap, bool hugePages) {
+	for (size_t i = 0; i < HEAP_CLASS_COUNT; i++) {
+		heap->free[i] = NULL;
+		heap->top[i] = NULL;
+		heap->end[i] = NULL;
+	}
+	heap->pages = NULL;
+	heap->pageCount = 0;
+	heap->cellBytes = 0;
+	heap->regions = NULL;
+	heap->releasedPages = 0;
+	heap->hugePages = hugePages;
+}
+
+void freeHeap(Heap* heap) {
+	HeapRegion* region = heap->regions;
+	while (region != NULL) {
+		HeapRegion* next = region->next;
+		unmapRegion(region->base);
+		free(region);
+		region = next;
+	}
+	initHeap(heap, heap->hugePages);
+}
+
+// Takes a released page if there is one, else the next page of the newest region, mapping a new region
+// once that is used up.
+static HeapPage* allocatePage(Heap* heap) {
+	for (HeapRegion* region = heap->regions; heap->releasedPages > 0 && region != NULL; region = region->next) {
+		if (region->freePages == 0) continue;
+
+		size_t index = 0;
+		while ((region->freePages & ((uint64_t)1 << index)) == 0) index++;
+
+		HeapPage* page = (HeapPage*)(region->base + index * HEAP_PAGE_SIZE);
+		if (!reusePage(page)) return NULL;
+		page->region = region;
+		region->freePages &= ~((uint64_t)1 << index);
+		region->usedPages++;
+		heap->releasedPages--;
+		return page;
+	}
+
+	HeapRegion* region = heap->regions;
+	if (region == NULL || region->carvedPages == HEAP_REGION_PAGES) {
+		region = malloc(sizeof(HeapRegion));
+		if (region == NULL) return NULL;
+		region->base = mapRegion(heap->hugePages);
+		if (region->base == NULL) {
+			free(region);
+			return NULL;
+		}
+		region->carvedPages = 0;
+		region->usedPages = 0;
+		region->freePages = 0;
+		region->next = heap->regions;
+		heap->regions = region;
+	}
+
+	HeapPage* page = (HeapPage*)(region->base + region->carvedPages * HEAP_PAGE_SIZE);
+	page->region = region;
+	region->carvedPages++;
+	region->usedPages++;
+	return page;
+}
+
+static void freePage(Heap* heap, HeapPage* page) {
+	HeapRegion* region = page->region;
+	if (--region->usedPages > 0) {
+		region->freePages |= (uint64_t)1 << (((char*)page - region->base) / HEAP_PAGE_SIZE);
+		heap->releasedPages++;
+		releasePage(page);
+		return;
+	}
+
+	for (uint64_t pages = region->freePages; pages != 0; pages &= pages - 1) heap->releasedPages--;
+
+	HeapRegion** link = &heap->regions;
+	while (*link != region) link = &(*link)->next;
+	*link = region->next;
+
+	unmapRegion(region->base);
+	free(region);
+}
+
+static inline void setCell(void* cell) {
+	HeapPage* page = heapPageOf(cell);
+	size_t index = ((uintptr_t)cell & (HEAP_PAGE_SIZE - 1)) / HEAP_CELL_GRANULARITY;
+	page->cells[index / HEAP_MARK_BITS] |= (size_t)1 << (index % HEAP_MARK_BITS);
+}
+
+static inline void clearCell(void* cell) {
+	HeapPage* page = heapPageOf(cell);
+	size_t index = ((uintptr_t)cell & (HEAP_PAGE_SIZE - 1)) / HEAP_CELL_GRANULARITY;
+	page->cells[index / HEAP_MARK_BITS] &= ~((size_t)1 << (index % HEAP_MARK_BITS));
+}
+
+static size_t sizeClass(size_t size) {
+	return heapCellSize(size) / HEAP_CELL_GRANULARITY - 1;
+}
+
+void* heapAllocate(Heap* heap, size_t size) {
+	size_t class = sizeClass(size);
+	size_t cellSize = heapCellSize(size);
+
+	HeapCell* cell = heap->free[class];
+	if (cell != NULL) {
+		heap->free[class] = cell->next;
+		heap->cellBytes += cellSize;
+		heapClearMark(cell);
+		setCell(cell);
+		return cell;
+	}
+
+	// Cells are handed out from the class's newest page in address order, so objects allocated together
+	// sit together.
+	if (heap->top[class] == NULL || (size_t)(heap->end[class] - heap->top[class]) < cellSize) {
+		HeapPage* page = allocatePage(heap);
+		if (page == NULL) return NULL;
+		page->next = heap->pages;
+		page->cellSize = cellSize;
+		page->liveBytes = 0;
+		page->isEvacuating = false;
+		memset(page->marks, 0, sizeof(page->marks));
+		memset(page->cells, 0, sizeof(page->cells));
+		heap->pages = page;
+		heap->pageCount++;
+
+		heap->top[class] = (char*)page + HEAP_PAGE_HEADER;
+		heap->end[class] = (char*)page + HEAP_PAGE_SIZE;
+	}
+
+	void* result = heap->top[class];
+	heap->top[class] += cellSize;
+	heap->cellBytes += cellSize;
+	setCell(result);
+	return result;
+}
+
+void heapFree(Heap* heap, void* cell, size_t size) {
+	size_t class = sizeClass(size);
+	clearCell(cell);
+	HeapCell* freed = cell;
+	freed->next = heap->free[class];
+	heap->free[class] = freed;
+	heap->cellBytes -= heapCellSize(size);
+}
+
+void heapClearMarks(Heap* heap) {
+	for (HeapPage* page = heap->pages; page != NULL; page = page->next) {
+		memset(page->marks, 0, sizeof(page->marks));
+	}
+}
+
+void heapClearLive(Heap* heap) {
+	for (HeapPage* page = heap->pages; page != NULL; page = page->next) {
+		page->liveBytes = 0;
+	}
+}
+
+bool heapBeginEvacuation(Heap* heap, size_t occupancy) {
+	bool evacuating = false;
+
+	for (HeapPage* page = heap->pages; page != NULL; page = page->next) {
+		// Cells are still being carved from the newest page of each class.
+		size_t class = sizeClass(page->cellSize);
+		bool isNewest = heap->top[class] > (char*)page && heap->top[class] <= (char*)page + HEAP_PAGE_SIZE;
+
+		page->isEvacuating = !isNewest && page->liveBytes * 100 < (HEAP_PAGE_SIZE - HEAP_PAGE_HEADER) * occupancy;
+		evacuating |= page->isEvacuating;
+	}
+	if (!evacuating) return false;
+
+	for (size_t i = 0; i < HEAP_CLASS_COUNT; i++) {
+		HeapCell** link = &heap->free[i];
+		while (*link != NULL) {
+			if (heapIsEvacuating(*link)) *link = (*link)->next;
+			else link = &(*link)->next;
+		}
+	}
+	return true;
+}
+
+void heapEndEvacuation(Heap* heap) {
+	HeapPage** link = &heap->pages;
+	while (*link != NULL) {
+		HeapPage* page = *link;
+		if (!page->isEvacuating) {
+			link = &page->next;
+			continue;
+		}
+
+		*link = page->next;
+		heap->cellBytes -= page->liveBytes;
+		heap->pageCount--;
+		freePage(heap, page);
+	}
+}
\ No newline at end of file
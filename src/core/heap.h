@@ -0,0 +1,127 @@
+#pragma once
+#include <core/common.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Objects are carved from pages of HEAP_PAGE_SIZE bytes rather than malloced one at a time. Each page
+// holds cells of a single size class, and size classes are HEAP_CELL_GRANULARITY bytes apart up to
+// HEAP_MAX_CELL. Freed cells are kept on a free list for their class. Pages are only released when
+// the heap is evacuated or freed.
+// Pages are in turn carved from regions of HEAP_REGION_SIZE bytes, aligned to their size, so a region
+// can be backed by a single huge page where the system supports it. A released page is returned to the
+// system but keeps its place in the region, and the region is unmapped once none of its pages are used.
+#define HEAP_PAGE_SIZE (64 * 1024)
+#define HEAP_REGION_SIZE (2 * 1024 * 1024)
+#define HEAP_REGION_PAGES (HEAP_REGION_SIZE / HEAP_PAGE_SIZE)
+#define HEAP_CELL_GRANULARITY 8
+#define HEAP_MAX_CELL 256
+#define HEAP_CLASS_COUNT (HEAP_MAX_CELL / HEAP_CELL_GRANULARITY)
+
+#define HEAP_MARK_BITS (sizeof(size_t) * 8)
+#define HEAP_MARK_WORDS (HEAP_PAGE_SIZE / HEAP_CELL_GRANULARITY / HEAP_MARK_BITS)
+
+typedef struct HeapCell {
+	struct HeapCell* next;
+} HeapCell;
+
+typedef struct HeapRegion {
+	struct HeapRegion* next;
+	char* base;
+	size_t carvedPages; // Pages handed out from the start of the region so far.
+	size_t usedPages;
+	uint64_t freePages; // A bit for each released page of those carved.
+} HeapRegion;
+
+// Pages are aligned to HEAP_PAGE_SIZE, so a cell's page is found from its address. The collector's mark
+// bits are kept here rather than in the objects, so marking and sweeping leave live objects untouched.
+// The cells bitmap has a bit set at the start of each allocated cell, so the collector can walk a page's
+// objects in address order without following pointers.
+typedef struct HeapPage {
+	struct HeapPage* next;
+	HeapRegion* region;
+	size_t cellSize;
+	size_t liveBytes; // Counted by the collector before an evacuation.
+	bool isEvacuating;
+	size_t marks[HEAP_MARK_WORDS]; // One bit for each HEAP_CELL_GRANULARITY bytes of the page.
+	size_t cells[HEAP_MARK_WORDS];
+} HeapPage;
+
+typedef struct {
+	HeapCell* free[HEAP_CLASS_COUNT];
+	char* top[HEAP_CLASS_COUNT]; // Next unused cell of the class's newest page.
+	char* end[HEAP_CLASS_COUNT];
+	HeapPage* pages; // Newest first.
+	size_t pageCount;
+	size_t cellBytes; // Bytes in cells which are allocated.
+	HeapRegion* regions; // Newest first, only the newest may have pages left to carve.
+	size_t releasedPages; // Pages released in regions which are still mapped, ready for reuse.
+	bool hugePages; // Asks the system to back regions with huge pages.
+} Heap;
+
+void initHeap(Heap* heap, bool hugePages);
+
+void freeHeap(Heap* heap);
+
+// The size of the cell an object of size bytes is given.
+static inline size_t heapCellSize(size_t size) {
+	return (size + HEAP_CELL_GRANULARITY - 1) & ~(size_t)(HEAP_CELL_GRANULARITY - 1);
+}
+
+// Returns NULL if out of memory. size must be at most HEAP_MAX_CELL. The cell starts unmarked.
+void* heapAllocate(Heap* heap, size_t size);
+
+void heapFree(Heap* heap, void* cell, size_t size);
+
+// Unmarks every cell in the heap.
+void heapClearMarks(Heap* heap);
+
+static inline HeapPage* heapPageOf(void* cell) {
+	return (HeapPage*)((uintptr_t)cell & ~(uintptr_t)(HEAP_PAGE_SIZE - 1));
+}
+
+// Returns the word holding cell's mark bit, and sets bit to the mask of it.
+static inline size_t* heapMarkWord(void* cell, size_t* bit) {
+	HeapPage* page = heapPageOf(cell);
+	size_t index = ((uintptr_t)cell & (HEAP_PAGE_SIZE - 1)) / HEAP_CELL_GRANULARITY;
+	*bit = (size_t)1 << (index % HEAP_MARK_BITS);
+	return &page->marks[index / HEAP_MARK_BITS];
+}
+
+static inline bool heapIsMarked(void* cell) {
+	size_t bit;
+	return (*heapMarkWord(cell, &bit) & bit) != 0;
+}
+
+static inline void heapSetMark(void* cell) {
+	size_t bit;
+	*heapMarkWord(cell, &bit) |= bit;
+}
+
+static inline void heapClearMark(void* cell) {
+	size_t bit;
+	*heapMarkWord(cell, &bit) &= ~bit;
+}
+
+// The cell starting at bit of word index of a page's bitmaps.
+static inline void* heapCellAt(HeapPage* page, size_t index, size_t bit) {
+	return (char*)page + (index * HEAP_MARK_BITS + bit) * HEAP_CELL_GRANULARITY;
+}
+
+// Evacuation empties the pages which are less than occupancy percent used, once the caller has counted
+// the live bytes of each page with heapCountLive. Their free cells are dropped, so the caller can move
+// their live cells elsewhere with heapAllocate before heapEndEvacuation releases them.
+void heapClearLive(Heap* heap);
+
+static inline void heapCountLive(void* cell) {
+	HeapPage* page = heapPageOf(cell);
+	page->liveBytes += page->cellSize;
+}
+
+static inline bool heapIsEvacuating(void* cell) {
+	return heapPageOf(cell)->isEvacuating;
+}
+
+// Returns false if no page is sparse enough to evacuate.
+bool heapBeginEvacuation(Heap* heap, size_t occupancy);
+
+void heapEndEvacuation(Heap* heap);
\ No newline at end of file
@@ -2,6 +2,9 @@
 #include <core/common.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <core/thread.h>
 #include <vm/object.h>
 #include <debug/debugFlags.h>
 #include <compiler/compiler.h>
@@ -10,26 +13,195 @@
 #include <stdio.h>
 #endif
 
-#define GC_HEAP_GROW_FACTOR 2
+// Objects a slice processes between checks of its deadline, as reading the clock is comparatively slow.
+#ifdef FOX_DEBUG_STRESS_GC
+#define GC_CLOCK_INTERVAL 1
+#else
+#define GC_CLOCK_INTERVAL 256
+#endif
+
+// Objects a parallel marker blackens between checks for idle markers to share its work with.
+#define GC_SHARE_INTERVAL 64
+
+static const char* gcOptions[] = { "initial-heap", "growth", "min-heap", "max-heap", "pause", "threads", "stats", "huge-pages" };
+
+static bool parseSize(const char* string, size_t* size) {
+	char* end;
+	unsigned long long value = strtoull(string, &end, 10);
+	if (end == string) return false;
+
+	switch (toupper(*end)) {
+		case 'K': value *= 1024; end++; break;
+		case 'M': value *= 1024 * 1024; end++; break;
+		case 'G': value *= 1024 * 1024 * 1024; end++; break;
+	}
+	if (*end != '\0') return false;
+
+	*size = (size_t)value;
+	return true;
+}
+
+bool setGCOption(GCConfig* config, const char* name, const char* value) {
+	if (strcmp(name, "initial-heap") == 0) return parseSize(value, &config->initialHeap);
+	if (strcmp(name, "min-heap") == 0) return parseSize(value, &config->minHeap);
+	if (strcmp(name, "max-heap") == 0) return parseSize(value, &config->maxHeap);
+	if (strcmp(name, "pause") == 0) return parseSize(value, &config->pauseTarget);
+	if (strcmp(name, "threads") == 0) return parseSize(value, &config->markThreads);
+
+	if (strcmp(name, "huge-pages") == 0) {
+		if (strcmp(value, "1") == 0 || strcmp(value, "on") == 0) config->hugePages = true;
+		else if (strcmp(value, "0") == 0 || strcmp(value, "off") == 0) config->hugePages = false;
+		else return false;
+		return true;
+	}
+
+	if (strcmp(name, "stats") == 0) {
+		if (*value == '\0') return false;
+		config->statsPath = value;
+		return true;
+	}
+
+	if (strcmp(name, "growth") == 0) {
+		char* end;
+		double factor = strtod(value, &end);
+		// The heap must be allowed to grow between collections, or every allocation would collect.
+		if (end == value || *end != '\0' || !(factor > 1)) return false;
+		config->growFactor = factor;
+		return true;
+	}
+
+	return false;
+}
+
+GCConfig* gcConfig() {
+	static GCConfig config;
+	static bool isLoaded = false;
+	if (isLoaded) return &config;
+	isLoaded = true;
+
+	config.initialHeap = GC_INITIAL_HEAP;
+	config.growFactor = GC_HEAP_GROW_FACTOR;
+	config.minHeap = GC_MIN_HEAP;
+	config.maxHeap = GC_MAX_HEAP;
+	config.pauseTarget = GC_PAUSE_TARGET;
+	config.markThreads = GC_MARK_THREADS;
+	config.statsPath = NULL;
+	config.hugePages = false;
+
+	for (size_t i = 0; i < sizeof(gcOptions) / sizeof(gcOptions[0]); i++) {
+		char variable[32] = "FOX_GC_";
+		size_t length = strlen(variable);
+		for (const char* c = gcOptions[i]; *c != '\0'; c++) {
+			variable[length++] = *c == '-' ? '_' : (char)toupper(*c);
+		}
+		variable[length] = '\0';
+
+		char* value = getenv(variable);
+		if (value != NULL && !setGCOption(&config, gcOptions[i], value)) {
+			fprintf(stderr, "Ignoring invalid %s value '%s'.\n", variable, value);
+		}
+	}
+
+	return &config;
+}
+
+void dumpGCStats(VM* vm) {
+	const char* path = gcConfig()->statsPath;
+	if (path == NULL) return;
+
+	FILE* file = strcmp(path, "-") == 0 ? stderr : fopen(path, "w");
+	if (file == NULL) {
+		fprintf(stderr, "Could not write GC stats to '%s'.\n", path);
+		return;
+	}
+
+	Buffer buffer;
+	initBuffer(&buffer);
+	writeGCStats(&vm->gcStats, &buffer);
+	fwrite(buffer.chars, 1, buffer.length, file);
+	fputc('\n', file);
+	freeBuffer(&buffer);
+
+	if (file != stderr) fclose(file);
+}
+
+// The threshold for the next full collection, growFactor times the heap left by this one, within the
+// configured bounds. A heap which has outgrown the maximum is still given a nursery's worth of room,
+// rather than being collected on every allocation.
+static size_t nextThreshold(VM* vm) {
+	size_t threshold = (size_t)(vm->bytesAllocated * vm->gcGrowFactor);
+	if (threshold < vm->gcMinHeap) threshold = vm->gcMinHeap;
+
+	if (vm->gcMaxHeap != 0 && threshold > vm->gcMaxHeap) {
+		size_t least = vm->bytesAllocated + GC_NURSERY_SIZE;
+		threshold = vm->gcMaxHeap > least ? vm->gcMaxHeap : least;
+	}
+	return threshold;
+}
 
 void collectGarbage(VM* vm);
+static void stepGarbage(VM* vm);
+static void beginMarking(VM* vm);
+static void markGarbage(VM* vm);
 static void freeObject(VM* vm, Obj* object);
 
-void* reallocate(VM* vm, void* pointer, size_t oldSize, size_t size) {
+static inline bool isCollectionDue(VM* vm) {
+	return vm->bytesAllocated > vm->nextGC
+		|| (vm->gcPhase != GC_IDLE && vm->bytesAllocated > vm->nextGCStep)
+		|| (vm->gcPhase != GC_MARKING && vm->bytesAllocated > vm->nextMinorGC);
+}
+
+// Accounts for an allocation changing from oldSize to size bytes, first collecting if it is due.
+static void countAllocation(VM* vm, size_t oldSize, size_t size) {
 
 	vm->bytesAllocated += size - oldSize;
 
 #ifdef FOX_DEBUG_STRESS_GC
-	if (size > oldSize) {
-		collectGarbage(vm);
+	// Every growing allocation collects, rotating through minor collections, full ones marked in slices
+	// or all at once, lazy sweep steps and, after a full collection, a compaction.
+	if (size > oldSize && !vm->isCollecting) {
+		static size_t stressTick = 0;
+		stressTick++;
+
+		if (vm->gcPhase == GC_IDLE) {
+			if (stressTick % 16 == 0) {
+				collectGarbage(vm);
+				vm->shouldCompact = true;
+			}
+			else if (stressTick % 4 == 0) beginMarking(vm);
+			else collectYoung(vm);
+		}
+		else if (vm->gcPhase == GC_MARKING) {
+			if (stressTick % 8 == 0) markGarbage(vm);
+			else stepGarbage(vm);
+		}
+		else if (stressTick % 2 == 0) stepGarbage(vm);
+		else collectYoung(vm);
 	}
 #endif
 
 #ifndef FOX_DEBUG_DISABLE_GC
-	if (vm->bytesAllocated > vm->nextGC) {
-		collectGarbage(vm);
+	// Only growing allocations collect, frees made by the sweep must not restart it.
+	if (size > oldSize && !vm->isCollecting && isCollectionDue(vm)) {
+		uint64_t start = currentNanos();
+
+		// Minor collections wait for marking to finish, and incremental marking falls back to finishing
+		// at once if the heap outgrows it. Either way the old generation is then swept lazily.
+		if (vm->bytesAllocated > vm->nextGC) {
+			if (vm->gcPauseTarget == 0 || vm->gcPhase != GC_IDLE) markGarbage(vm);
+			else beginMarking(vm);
+		}
+		else if (vm->gcPhase != GC_IDLE && vm->bytesAllocated > vm->nextGCStep) stepGarbage(vm);
+		else collectYoung(vm);
+
+		recordGCTime(&vm->gcStats, GC_TIME_PAUSE, currentNanos() - start);
 	}
 #endif
+}
+
+void* reallocate(VM* vm, void* pointer, size_t oldSize, size_t size) {
+	countAllocation(vm, oldSize, size);
+
 	if (size == 0) {
 		free(pointer);
 		return NULL;
@@ -45,53 +217,178 @@ void* reallocate(VM* vm, void* pointer, size_t oldSize, size_t size) {
 	return p;
 }
 
-void markObject(VM* vm, Obj* object) {
+void* allocateCell(VM* vm, size_t size) {
+	size_t cellSize = heapCellSize(size);
+	countAllocation(vm, 0, cellSize);
+
+	void* cell = heapAllocate(&vm->heap, cellSize);
+	if (cell == NULL) {
+		fprintf(stderr, "Failed to reallocate memory.");
+		exit(1);
+	}
+
+	return cell;
+}
+
+void freeCell(VM* vm, void* cell) {
+	size_t cellSize = heapPageOf(cell)->cellSize;
+	vm->bytesAllocated -= cellSize;
+	heapFree(&vm->heap, cell, cellSize);
+}
+
+// Shared by the markers tracing in parallel. A marker with spare work hands some to idle ones through
+// shared, and the trace ends once every marker is idle with nothing left to share. Fields are only written
+// with lock held, sharedCount and idleCount atomically as busy markers poll them without it.
+typedef struct MarkPool {
+	Mutex lock;
+	Condition wake; // Broadcast when work is shared, a trace starts or ends, or the helpers should exit.
+	size_t sharedCount;
+	size_t sharedCapacity;
+	Obj** shared;
+	size_t markerCount; // The helpers and the VM's own marker.
+	size_t idleCount;
+	size_t trace; // Counts the traces started, so helpers know when to join one.
+	uint64_t deadline; // 0 when the trace has none.
+	bool isStopped; // Set once the deadline has passed.
+	bool isDone;
+	bool isExiting;
+	Thread* threads;
+	Marker* helpers;
+} MarkPool;
+
+void initMarker(Marker* marker, VM* vm) {
+	marker->vm = vm;
+	marker->grayCount = 0;
+	marker->grayCapacity = 0;
+	marker->grayStack = NULL;
+	marker->viewCount = 0;
+	marker->viewCapacity = 0;
+	marker->views = NULL;
+	marker->pool = NULL;
+}
+
+void freeMarker(Marker* marker) {
+	free(marker->grayStack);
+	free(marker->views);
+}
+
+static void reserveGray(Marker* marker, size_t count) {
+	if (marker->grayCapacity >= marker->grayCount + count) return;
+
+	size_t capacity = marker->grayCapacity < 8 ? 8 : marker->grayCapacity * 2;
+	if (capacity < marker->grayCount + count) capacity = marker->grayCount + count;
+
+	marker->grayStack = realloc(marker->grayStack, sizeof(Obj*) * capacity);
+	if (marker->grayStack == NULL) exit(1);
+	marker->grayCapacity = capacity;
+}
+
+static void markGray(Marker* marker, Obj* object) {
 	if (object == NULL) return;
-	if (object->isMarked) return;
+
+	if (marker->pool == NULL) {
+		if (heapIsMarked(object)) return;
+		if (object->isOld && marker->vm->isCollectingYoung) return;
+		heapSetMark(object);
+	}
+	// Only full collections mark in parallel. Markers may race to mark the same object, and only the one
+	// which sets its mark traces it.
+	else {
+		size_t bit;
+		size_t* word = heapMarkWord(object, &bit);
+		if ((atomicLoadSize(word) & bit) != 0 || (atomicFetchOrSize(word, bit) & bit) != 0) return;
+	}
 
 #ifdef FOX_DEBUG_LOG_GC
 	printf("%p mark ", (void*)object);
-	char* string = objectToString(vm, OBJ_VAL(object));
+	char* string = objectToString(marker->vm, OBJ_VAL(object));
 	printf("%s\n", string);
 	free(string);
 #endif
 
-	object->isMarked = true;
+	reserveGray(marker, 1);
+	marker->grayStack[marker->grayCount++] = object;
+}
 
-	if (vm->grayCapacity < vm->grayCount + 1) {
-		vm->grayCapacity = vm->grayCapacity < 8 ? 8 : vm->grayCapacity * 2;
-		vm->grayStack = realloc(vm->grayStack, sizeof(Obj*) * vm->grayCapacity);
-		if (vm->grayStack == NULL) exit(1);
+static void markGrayValue(Marker* marker, Value value) {
+	if (!IS_OBJ(value)) return;
+	markGray(marker, AS_OBJ(value));
+}
+
+static void markEntries(Marker* marker, Table* table) {
+	for (int i = 0; i <= table->capacity; i++) {
+		Entry* entry = &table->entries[i];
+		markGray(marker, (Obj*)entry->key);
+		markGrayValue(marker, entry->value);
 	}
+}
 
-	vm->grayStack[vm->grayCount++] = object;
+static void markValueEntries(Marker* marker, ValueTable* table) {
+	for (int i = 0; i <= table->capacity; i++) {
+		if (!CTRL_IS_FULL(table->control[i])) continue;
+		ValueEntry* entry = &table->entries[i];
+		markGrayValue(marker, entry->key);
+		markGrayValue(marker, entry->value);
+	}
+}
 
+void markObject(VM* vm, Obj* object) {
+	markGray(&vm->marker, object);
 }
 
 void markValue(VM* vm, Value value) {
-	if (!IS_OBJ(value)) return;
-	markObject(vm, AS_OBJ(value));
+	markGrayValue(&vm->marker, value);
 }
 
 void markTable(VM* vm, Table* table) {
-	for (int i = 0; i <= table->capacity; i++) {
-		Entry* entry = &table->entries[i];
-		markObject(vm, (Obj*)entry->key);
-		markValue(vm, entry->value);
+	markEntries(&vm->marker, table);
+}
+
+void markValueTable(VM* vm, ValueTable* table) {
+	markValueEntries(&vm->marker, table);
+}
+
+void rememberObject(VM* vm, Obj* object) {
+	object->isRemembered = true;
+
+	if (vm->rememberedCapacity < vm->rememberedCount + 1) {
+		vm->rememberedCapacity = vm->rememberedCapacity < 8 ? 8 : vm->rememberedCapacity * 2;
+		vm->remembered = realloc(vm->remembered, sizeof(Obj*) * vm->rememberedCapacity);
+		if (vm->remembered == NULL) exit(1);
+	}
+
+	vm->remembered[vm->rememberedCount++] = object;
+}
+
+static void forgetRemembered(VM* vm) {
+	for (size_t i = 0; i < vm->rememberedCount; i++) {
+		Obj* object = vm->remembered[i];
+		object->isRemembered = false;
+		if (object->type == OBJ_LIST) ((ObjList*)object)->items.dirty = SIZE_MAX;
 	}
+	vm->rememberedCount = 0;
 }
 
-static void markArray(VM* vm, ValueArray* array) {
+static void pushView(Marker* marker, ObjString* view) {
+	if (marker->viewCapacity < marker->viewCount + 1) {
+		marker->viewCapacity = marker->viewCapacity < 8 ? 8 : marker->viewCapacity * 2;
+		marker->views = realloc(marker->views, sizeof(ObjString*) * marker->viewCapacity);
+		if (marker->views == NULL) exit(1);
+	}
+	marker->views[marker->viewCount++] = view;
+}
+
+static void markArray(Marker* marker, ValueArray* array) {
 	for (size_t i = 0; i < array->count; i++) {
-		markValue(vm, array->values[i]);
+		markGrayValue(marker, array->values[i]);
 	}
 }
 
-static void blackenObject(VM* vm, Obj* object) {
+static void blackenObject(Marker* marker, Obj* object) {
 
 #ifdef FOX_DEBUG_LOG_GC
 	printf("%p blacken ", (void*)object);
-	char* string = objectToString(vm, OBJ_VAL(object));
+	char* string = objectToString(marker->vm, OBJ_VAL(object));
 	printf("%s\n", string);
 	free(string);
 #endif
@@ -100,63 +397,333 @@ static void blackenObject(VM* vm, Obj* object) {
 
 		case OBJ_LIST: {
 			ObjList* list = (ObjList*)object;
-			markArray(vm, &list->items);
+			markArray(marker, &list->items);
+			break;
+		}
+		case OBJ_MAP: {
+			ObjMap* map = (ObjMap*)object;
+			markValueEntries(marker, &map->items);
 			break;
 		}
 		case OBJ_CLASS: {
 			ObjClass* klass = (ObjClass*)object;
-			markObject(vm, (Obj*)klass->name);
-			markTable(vm, &klass->methods);
+			markGray(marker, (Obj*)klass->name);
+			markEntries(marker, &klass->methods);
 			break;
 		}
 
 		case OBJ_INSTANCE: {
 			ObjInstance* instance = (ObjInstance*)object;
-			markObject(vm, (Obj*)instance->class);
-			markTable(vm, &instance->fields);
+			markGray(marker, (Obj*)instance->class);
+			markEntries(marker, &instance->fields);
 			break;
 		}
 
 		case OBJ_BOUND_METHOD: {
 			ObjBoundMethod* bound = (ObjBoundMethod*)object;
-			markValue(vm, bound->receiver);
-			markObject(vm, (Obj*)bound->method);
+			markGrayValue(marker, bound->receiver);
+			markGray(marker, (Obj*)bound->method);
 			break;
 		}
 
 		case OBJ_CLOSURE: {
 			ObjClosure* closure = (ObjClosure*)object;
-			markObject(vm, (Obj*)closure->function);
+			markGray(marker, (Obj*)closure->function);
 			for (size_t i = 0; i < closure->upvalueCount; i++) {
-				markObject(vm, (Obj*)closure->upvalues[i]);
+				markGray(marker, (Obj*)closure->upvalues[i]);
 			}
 			break;
 		}
 
 		case OBJ_FUNCTION: {
 			ObjFunction* function = (ObjFunction*)object;
-			markObject(vm, (Obj*)function->name);
-			markArray(vm, &function->chunk.constants);
+			markGray(marker, (Obj*)function->name);
+			markArray(marker, &function->chunk.constants);
 			break;
 		}
 
 		case OBJ_UPVALUE:
-			markValue(vm, ((ObjUpvalue*)object)->closed);
+			markGrayValue(marker, ((ObjUpvalue*)object)->closed);
+			break;
+		case OBJ_STRING: {
+			ObjString* string = (ObjString*)object;
+			if (string->parent == NULL) break;
+
+			pushView(marker, string);
 			break;
+		}
 		case OBJ_NATIVE:
-		case OBJ_STRING:
+		case OBJ_ARRAY:
 			break;
 	}
 }
 
+// Only the dirty values of a remembered list can be young, the rest were old when it was last collected.
+static void blackenRemembered(VM* vm, Obj* object) {
+	if (object->type != OBJ_LIST) {
+		blackenObject(&vm->marker, object);
+		return;
+	}
+
+	ValueArray* items = &((ObjList*)object)->items;
+	for (size_t i = items->dirty; i < items->count; i++) {
+		markValue(vm, items->values[i]);
+	}
+}
+
+// Moves count objects from the top of marker's gray stack to the pool. Called with the pool locked.
+static void giveWork(Marker* marker, size_t count) {
+	MarkPool* pool = marker->pool;
+
+	if (pool->sharedCapacity < pool->sharedCount + count) {
+		size_t capacity = pool->sharedCapacity < 8 ? 8 : pool->sharedCapacity * 2;
+		if (capacity < pool->sharedCount + count) capacity = pool->sharedCount + count;
+
+		pool->shared = realloc(pool->shared, sizeof(Obj*) * capacity);
+		if (pool->shared == NULL) exit(1);
+		pool->sharedCapacity = capacity;
+	}
+
+	marker->grayCount -= count;
+	memcpy(&pool->shared[pool->sharedCount], &marker->grayStack[marker->grayCount], sizeof(Obj*) * count);
+	atomicStoreSize(&pool->sharedCount, pool->sharedCount + count);
+
+	broadcastCondition(&pool->wake);
+}
+
+// Takes a fair share of the pool's work for marker, which is still counted as idle. Called with the pool
+// locked.
+static void takeWork(Marker* marker) {
+	MarkPool* pool = marker->pool;
+
+	size_t count = (pool->sharedCount + pool->idleCount - 1) / pool->idleCount;
+	reserveGray(marker, count);
+
+	atomicStoreSize(&pool->sharedCount, pool->sharedCount - count);
+	memcpy(&marker->grayStack[marker->grayCount], &pool->shared[pool->sharedCount], sizeof(Obj*) * count);
+	marker->grayCount += count;
+}
+
+// Blackens marker's gray objects, handing half of them to the pool whenever it runs dry while another
+// marker is idle. Stops early once the trace's deadline passes.
+static void traceShared(Marker* marker) {
+	MarkPool* pool = marker->pool;
+	size_t work = 0;
+
+	while (marker->grayCount > 0) {
+		blackenObject(marker, marker->grayStack[--marker->grayCount]);
+		if (++work % GC_SHARE_INTERVAL != 0) continue;
+
+		if (atomicLoadBool(&pool->isStopped)) return;
+		if (pool->deadline != 0 && currentMicros() >= pool->deadline) {
+			atomicStoreBool(&pool->isStopped, true);
+			return;
+		}
+
+		if (marker->grayCount > 1 && atomicLoadSize(&pool->idleCount) > 0 && atomicLoadSize(&pool->sharedCount) == 0) {
+			lockMutex(&pool->lock);
+			giveWork(marker, marker->grayCount / 2);
+			unlockMutex(&pool->lock);
+		}
+	}
+}
+
+// Traces with marker until every marker is idle and the pool is empty, or the trace is stopped. Called,
+// and returns, with the pool locked.
+static void runMarker(Marker* marker) {
+	MarkPool* pool = marker->pool;
+
+	for (;;) {
+		while (pool->sharedCount == 0 || atomicLoadBool(&pool->isStopped)) {
+			if (pool->isDone) return;
+			if (pool->idleCount == pool->markerCount) {
+				pool->isDone = true;
+				broadcastCondition(&pool->wake);
+				return;
+			}
+			waitCondition(&pool->wake, &pool->lock);
+		}
+
+		takeWork(marker);
+		atomicStoreSize(&pool->idleCount, pool->idleCount - 1);
+		unlockMutex(&pool->lock);
+
+		traceShared(marker);
+
+		lockMutex(&pool->lock);
+		// Work left when the trace stops goes back to the pool, for the VM to pick up in its next slice.
+		if (marker->grayCount > 0) giveWork(marker, marker->grayCount);
+		atomicStoreSize(&pool->idleCount, pool->idleCount + 1);
+	}
+}
+
+static void markHelper(void* argument) {
+	Marker* marker = (Marker*)argument;
+	MarkPool* pool = marker->pool;
+	size_t trace = 0;
+
+	lockMutex(&pool->lock);
+	for (;;) {
+		while (pool->trace == trace && !pool->isExiting) waitCondition(&pool->wake, &pool->lock);
+		if (pool->isExiting) break;
+
+		trace = pool->trace;
+		runMarker(marker);
+	}
+	unlockMutex(&pool->lock);
+}
+
+static MarkPool* startMarkHelpers(VM* vm) {
+	MarkPool* pool = malloc(sizeof(MarkPool));
+	if (pool == NULL) exit(1);
+
+	initMutex(&pool->lock);
+	initCondition(&pool->wake);
+	pool->sharedCount = 0;
+	pool->sharedCapacity = 0;
+	pool->shared = NULL;
+	pool->trace = 0;
+	pool->deadline = 0;
+	pool->isStopped = false;
+	pool->isDone = false;
+	pool->isExiting = false;
+	pool->threads = malloc(sizeof(Thread) * vm->gcMarkThreads);
+	pool->helpers = malloc(sizeof(Marker) * vm->gcMarkThreads);
+	if (pool->threads == NULL || pool->helpers == NULL) exit(1);
+
+	// Marking carries on with however many helpers could be started.
+	size_t started = 0;
+	for (; started < vm->gcMarkThreads; started++) {
+		Marker* helper = &pool->helpers[started];
+		initMarker(helper, vm);
+		helper->pool = pool;
+		if (!startThread(&pool->threads[started], markHelper, helper)) {
+			freeMarker(helper);
+			break;
+		}
+	}
+	pool->markerCount = started + 1;
+	pool->idleCount = pool->markerCount;
+
+	vm->markPool = pool;
+	return pool;
+}
+
+void stopMarkHelpers(VM* vm) {
+	MarkPool* pool = vm->markPool;
+	if (pool == NULL) return;
+
+	lockMutex(&pool->lock);
+	pool->isExiting = true;
+	broadcastCondition(&pool->wake);
+	unlockMutex(&pool->lock);
+
+	for (size_t i = 0; i < pool->markerCount - 1; i++) {
+		joinThread(pool->threads[i]);
+		freeMarker(&pool->helpers[i]);
+	}
+
+	freeCondition(&pool->wake);
+	freeMutex(&pool->lock);
+	free(pool->shared);
+	free(pool->threads);
+	free(pool->helpers);
+	free(pool);
+	vm->markPool = NULL;
+}
+
+// Traces the VM's gray objects together with the helper threads, until deadline if it is not 0. Returns
+// whether the gray stack was emptied, as traceSlice.
+static bool traceParallel(VM* vm, uint64_t deadline) {
+	MarkPool* pool = vm->markPool != NULL ? vm->markPool : startMarkHelpers(vm);
+	Marker* marker = &vm->marker;
+
+	lockMutex(&pool->lock);
+
+	atomicStoreSize(&pool->idleCount, pool->markerCount);
+	pool->deadline = deadline;
+	atomicStoreBool(&pool->isStopped, false);
+	pool->isDone = false;
+	pool->trace++;
+
+	marker->pool = pool;
+	giveWork(marker, marker->grayCount);
+	runMarker(marker);
+	marker->pool = NULL;
+
+	// Every helper is idle now, so the views they blackened can be gathered.
+	for (size_t i = 0; i < pool->markerCount - 1; i++) {
+		Marker* helper = &pool->helpers[i];
+		for (size_t j = 0; j < helper->viewCount; j++) {
+			pushView(marker, helper->views[j]);
+		}
+		helper->viewCount = 0;
+	}
+
+	reserveGray(marker, pool->sharedCount);
+	memcpy(&marker->grayStack[marker->grayCount], pool->shared, sizeof(Obj*) * pool->sharedCount);
+	marker->grayCount += pool->sharedCount;
+	atomicStoreSize(&pool->sharedCount, 0);
+
+	unlockMutex(&pool->lock);
+
+	return marker->grayCount == 0;
+}
+
+// Only full collections trace in parallel, minor ones are too short to be worth waking the helpers for.
+static bool isParallel(VM* vm) {
+#ifdef FOX_DEBUG_LOG_GC
+	return false;
+#else
+	return vm->gcMarkThreads > 0 && !vm->isCollectingYoung;
+#endif
+}
+
 static void traceReferences(VM* vm) {
-	while (vm->grayCount > 0) {
-		Obj* object = vm->grayStack[--vm->grayCount];
-		blackenObject(vm, object);
+	uint64_t start = currentNanos();
+
+	if (isParallel(vm)) {
+		traceParallel(vm, 0);
+	}
+	else {
+		Marker* marker = &vm->marker;
+		while (marker->grayCount > 0) {
+			Obj* object = marker->grayStack[--marker->grayCount];
+			blackenObject(marker, object);
+		}
+	}
+
+	recordGCTime(&vm->gcStats, GC_TIME_TRACE, currentNanos() - start);
+}
+
+// As traceReferences, stopping at deadline. Returns whether the gray stack was emptied.
+static bool traceSlice(VM* vm, uint64_t deadline) {
+	uint64_t start = currentNanos();
+	bool isDone = true;
+
+	if (isParallel(vm)) {
+		isDone = traceParallel(vm, deadline);
+	}
+	else {
+		Marker* marker = &vm->marker;
+		size_t work = 0;
+		while (marker->grayCount > 0) {
+			Obj* object = marker->grayStack[--marker->grayCount];
+			blackenObject(marker, object);
+			if (++work % GC_CLOCK_INTERVAL == 0 && currentMicros() >= deadline) {
+				isDone = marker->grayCount == 0;
+				break;
+			}
+		}
 	}
+
+	recordGCTime(&vm->gcStats, GC_TIME_TRACE, currentNanos() - start);
+	return isDone;
 }
 
 static void markRoots(VM* vm) {
+	uint64_t start = currentNanos();
+
 	for (Value* slot = vm->stack; slot < vm->stackTop; slot++) {
 		markValue(vm, *slot);
 	}
@@ -169,65 +736,566 @@ static void markRoots(VM* vm) {
 		markObject(vm, (Obj*)upvalue);
 	}
 
-	markTable(vm, &vm->globals);
-	markTable(vm, &vm->exports);
+	for (size_t i = 0; i < vm->moduleCount; i++) {
+		Module* module = vm->modules[i];
+		markTable(vm, &module->globals);
+		markTable(vm, &module->imports);
+		markObject(vm, (Obj*)module->exports);
+		markObject(vm, (Obj*)module->filepath);
+	}
+
+	markTable(vm, &vm->loadedModules);
+	markTable(vm, &vm->builtins);
 	markTable(vm, &vm->stringMethods);
 	markTable(vm, &vm->listMethods);
-	markObject(vm, &vm->filepath->obj);
-	markObject(vm, &vm->basePath->obj);
-	markObject(vm, &vm->importClass->obj);
-	markObject(vm, &vm->objectClass->obj);
+	markTable(vm, &vm->mapMethods);
+	markTable(vm, &vm->arrayMethods);
+	// These are still NULL if a collection runs while the VM is being set up.
+	markObject(vm, (Obj*)vm->basePath);
+	markObject(vm, (Obj*)vm->importClass);
+	markObject(vm, (Obj*)vm->objectClass);
+	markObject(vm, (Obj*)vm->iteratorClass);
+	markObject(vm, (Obj*)vm->exceptionClass);
 	if(vm->compiler != NULL)
 		markCompilerRoots(vm->compiler);
+
+	recordGCTime(&vm->gcStats, GC_TIME_ROOTS, currentNanos() - start);
+}
+
+// Live views keep their parent alive only while they use a fair share of it. Otherwise each view
+// copies out its own chars so the parent can be freed. Only the views marked by this collection are
+// checked, as blackenObject collects them in the VM's marker.
+static inline bool isLive(VM* vm, Obj* object) {
+	return heapIsMarked(object) || (object->isOld && vm->isCollectingYoung);
 }
 
-static void sweep(VM* vm) {
-	Obj* previous = NULL;
-	Obj* object = vm->objects;
-	while (object != NULL) {
-		if (object->isMarked) {
-			object->isMarked = false;
-			previous = object;
-			object = object->next;
+static void retainStringViews(VM* vm) {
+	uint64_t start = currentNanos();
+	Marker* marker = &vm->marker;
+
+	for (size_t i = 0; i < marker->viewCount; i++) {
+		ObjString* view = marker->views[i];
+		if (view->parent != NULL && !isLive(vm, &view->parent->obj)) view->parent->retained += view->length;
+	}
+
+	for (size_t i = 0; i < marker->viewCount; i++) {
+		ObjString* view = marker->views[i];
+		ObjString* parent = view->parent;
+		if (parent == NULL || isLive(vm, &parent->obj)) continue;
+
+		if (parent->retained * 4 >= parent->length) {
+			heapSetMark(parent); // Strings hold no references, so there is nothing to trace.
+			parent->retained = 0;
+			continue;
+		}
+
+		char* chars = ALLOCATE(vm, char, view->length + 1);
+		memcpy(chars, view->chars, view->length);
+		chars[view->length] = '\0';
+		view->chars = chars;
+		view->parent = NULL;
+	}
+
+	marker->viewCount = 0;
+
+	recordGCTime(&vm->gcStats, GC_TIME_STRINGS, currentNanos() - start);
+}
+
+// Frees an unreached object, first removing it from strings if it is an interned string.
+static void freeUnreached(VM* vm, Table* strings, Obj* object) {
+	if (object->type == OBJ_STRING && ((ObjString*)object)->interned) tableDelete(strings, (ObjString*)object);
+
+	size_t before = vm->bytesAllocated;
+	vm->gcStats.objectsFreed[object->type]++;
+	freeObject(vm, object);
+	vm->gcStats.bytesFreed += before - vm->bytesAllocated;
+}
+
+// Dead strings leave tombstones behind in the intern table, rehash it once enough have built up.
+static void compactStrings(VM* vm) {
+	uint64_t start = currentNanos();
+	tableCompact(vm, &vm->strings);
+	recordGCTime(&vm->gcStats, GC_TIME_STRINGS, currentNanos() - start);
+}
+
+// The nursery grows with the heap. A minor collection may have to trace every remembered old object,
+// so this keeps their cost proportional to the allocation between them, as with full collections.
+// Minor collections are never sliced, so the nursery stays small enough to collect within the pause
+// target when one is set.
+static size_t nurserySize(VM* vm) {
+	size_t size = vm->bytesAllocated / GC_NURSERY_DIVISOR;
+	if (vm->gcPauseTarget != 0 && size > GC_NURSERY_MAX) size = GC_NURSERY_MAX;
+	return size > GC_NURSERY_SIZE ? size : GC_NURSERY_SIZE;
+}
+
+// Frees unmarked young objects, and promotes the survivors to the old generation.
+static void sweepYoung(VM* vm, Table* strings) {
+	uint64_t start = currentNanos();
+
+	for (size_t i = 0; i < vm->youngCount; i++) {
+		Obj* object = vm->youngObjects[i];
+		if (heapIsMarked(object)) {
+			object->isOld = true;
 		}
 		else {
-			Obj* unreached = object;
-			object = object->next;
-			if (previous != NULL) {
-				previous->next = object;
-			}
-			else {
-				vm->objects = object;
-			}
+			freeUnreached(vm, strings, object);
+		}
+	}
+	vm->youngCount = 0;
+
+	recordGCTime(&vm->gcStats, GC_TIME_SWEEP, currentNanos() - start);
+}
 
-			freeObject(vm, unreached);
+// Frees the old objects on the next page which the last marking left unmarked, reading the page's bitmaps
+// rather than the live objects. Every old object allocated since then is marked, either by the final pause
+// of marking or by the minor collection which promoted it, and young ones are left to minor collections.
+static void sweepNext(VM* vm, Table* strings) {
+	HeapPage* page = vm->unsweptPages;
+	vm->unsweptPages = page->next;
+
+	for (size_t i = 0; i < HEAP_MARK_WORDS; i++) {
+		size_t dead = page->cells[i] & ~page->marks[i];
+		for (size_t bit = 0; dead != 0; bit++, dead >>= 1) {
+			if ((dead & 1) == 0) continue;
+
+			Obj* object = heapCellAt(page, i, bit);
+			if (object->isOld) freeUnreached(vm, strings, object);
 		}
 	}
 }
 
-void collectGarbage(VM* vm) {
+static void finishSweeping(VM* vm) {
+	vm->gcPhase = GC_IDLE;
+	vm->nextGC = nextThreshold(vm);
+	recordGCHeap(&vm->gcStats, vm->bytesAllocated);
+
+	compactStrings(vm);
+
+	size_t pageBytes = vm->heap.pageCount * HEAP_PAGE_SIZE;
+	if (pageBytes >= GC_COMPACT_MIN_HEAP
+		&& vm->heap.cellBytes * 100 < pageBytes * GC_COMPACT_OCCUPANCY) {
+		vm->shouldCompact = true;
+	}
+
+#ifdef FOX_DEBUG_LOG_GC
+	printf("-- gc end\n");
+	printf("   %ld bytes allocated, next at %ld\n", vm->bytesAllocated, vm->nextGC);
+#endif
+}
+
+// Sweeps the pages due by sweepRate, which is paced to finish well before the next full collection.
+static void sweepStep(VM* vm) {
+	uint64_t start = currentNanos();
+	Table* strings = &vm->strings;
+
+	vm->sweepCredit += vm->sweepRate;
+	for (; vm->sweepCredit >= 1 && vm->unsweptPages != NULL; vm->sweepCredit--) {
+		sweepNext(vm, strings);
+	}
+	recordGCTime(&vm->gcStats, GC_TIME_SWEEP, currentNanos() - start);
+
+	if (vm->unsweptPages == NULL) finishSweeping(vm);
+}
+
+static void sweepAll(VM* vm) {
+	uint64_t start = currentNanos();
+	Table* strings = &vm->strings;
+	while (vm->unsweptPages != NULL) sweepNext(vm, strings);
+	recordGCTime(&vm->gcStats, GC_TIME_SWEEP, currentNanos() - start);
+
+	finishSweeping(vm);
+}
+
+// Starts a full collection. Marking then continues in slices between allocations, with the write
+// barrier marking anything stored into an object which has already been traced.
+static void beginMarking(VM* vm) {
 #ifdef FOX_DEBUG_LOG_GC
 	printf("-- gc begin\n");
+#endif
+
+	vm->isCollecting = true;
+
+	// Marks are left set until the next full collection, as minor ones only mark young objects, which
+	// start unmarked. Clearing them here is a pass over each page's bitmap rather than every object.
+	heapClearMarks(&vm->heap);
+
+	vm->gcPhase = GC_MARKING;
+	markRoots(vm);
+
+	// Allocation during marking is not collected until it finishes, so bound how far the heap may grow.
+	vm->nextGC = nextThreshold(vm);
+	vm->nextGCStep = vm->bytesAllocated + GC_STEP_SIZE;
+
+	vm->isCollecting = false;
+}
+
+// The final pause of marking. The roots are marked again, as they are written without a barrier, then
+// the young generation is swept. The old one is left to be swept lazily, a few objects each time
+// GC_STEP_SIZE bytes are allocated.
+static void finishMarking(VM* vm) {
+	markRoots(vm);
+	traceReferences(vm);
+
+	retainStringViews(vm);
+
+	vm->gcStats.fullCycles++;
+
+	// Pages are added at the front of the list, so those allocated while sweeping are never reached.
+	vm->unsweptPages = vm->heap.pages;
+
+	// Aims to finish sweeping by the time half the allocation until the next full collection is done,
+	// while the heap still counts the unswept garbage.
+	vm->nextGC = nextThreshold(vm);
+	vm->nextGCStep = vm->bytesAllocated + GC_STEP_SIZE;
+	size_t steps = (vm->nextGC - vm->bytesAllocated) / 2 / GC_STEP_SIZE + 1;
+	vm->sweepRate = (double)vm->heap.pageCount / steps;
+	vm->sweepCredit = 0;
+
+	sweepYoung(vm, &vm->strings);
+
+	// Every young object has just been promoted, so no old object can be left referencing one.
+	forgetRemembered(vm);
+
+	vm->gcPhase = GC_SWEEPING;
+	vm->nextMinorGC = vm->bytesAllocated + nurserySize(vm);
+}
+
+// Runs one slice of the current full collection. Marking stops once it has taken gcPauseTarget.
+static void stepGarbage(VM* vm) {
+	vm->isCollecting = true;
+
+	if (vm->gcPhase == GC_MARKING) {
+#ifdef FOX_DEBUG_STRESS_GC
+		// A deadline long passed, as 0 means none, so slices stop at their first check of the clock and
+		// marking is spread over as many as it can be.
+		uint64_t deadline = 1;
+#else
+		uint64_t deadline = currentMicros() + vm->gcPauseTarget;
+#endif
+		if (traceSlice(vm, deadline)) finishMarking(vm);
+	}
+	else {
+		sweepStep(vm);
+	}
+
+	vm->nextGCStep = vm->bytesAllocated + GC_STEP_SIZE;
+
+	vm->isCollecting = false;
+}
+
+// Marks the whole heap at once, finishing any collection in progress first.
+static void markGarbage(VM* vm) {
+	// A sweep still in progress belongs to the previous collection.
+	if (vm->gcPhase == GC_SWEEPING) {
+		vm->isCollecting = true;
+		sweepAll(vm);
+	}
+
+	if (vm->gcPhase == GC_IDLE) beginMarking(vm);
+
+	vm->isCollecting = true;
+
+	traceReferences(vm);
+	finishMarking(vm);
+
+	vm->isCollecting = false;
+}
+
+void collectGarbage(VM* vm) {
+	uint64_t start = currentNanos();
+
+	markGarbage(vm);
+
+	vm->isCollecting = true;
+	sweepAll(vm);
+	vm->isCollecting = false;
+
+	recordGCTime(&vm->gcStats, GC_TIME_PAUSE, currentNanos() - start);
+}
+
+// Collects only the objects allocated since the last collection. Old objects are treated as live,
+// and the remembered set stands in for them as roots.
+void collectYoung(VM* vm) {
+#ifdef FOX_DEBUG_LOG_GC
+	printf("-- minor gc begin\n");
 	size_t before = vm->bytesAllocated;
 #endif
 
+	vm->isCollecting = true;
+	vm->isCollectingYoung = true;
+
 	markRoots(vm);
 
+	uint64_t start = currentNanos();
+	for (size_t i = 0; i < vm->rememberedCount; i++) {
+		blackenRemembered(vm, vm->remembered[i]);
+	}
+	forgetRemembered(vm);
+	recordGCTime(&vm->gcStats, GC_TIME_TRACE, currentNanos() - start);
+
 	traceReferences(vm);
 
-	tableRemoveWhite(&vm->strings);
+	retainStringViews(vm);
+
+	vm->isCollectingYoung = false;
+
+	sweepYoung(vm, &vm->strings);
 
-	sweep(vm);
+	vm->gcStats.minorCycles++;
+	vm->nextMinorGC = vm->bytesAllocated + nurserySize(vm);
 
-	vm->nextGC = vm->bytesAllocated * GC_HEAP_GROW_FACTOR;
+	compactStrings(vm);
+
+	vm->isCollecting = false;
 
 #ifdef FOX_DEBUG_LOG_GC
-	printf("-- gc end\n");
-	printf("   collected %ld bytes (from %ld to %ld) next at %ld\n", before - vm->bytesAllocated, before, vm->bytesAllocated, vm->nextGC);
+	printf("-- minor gc end\n");
+	printf("   collected %ld bytes (from %ld to %ld)\n", before - vm->bytesAllocated, before, vm->bytesAllocated);
 #endif
 
 }
 
+// An object moved out of an evacuated page is left holding its copy in place of its first field, as only
+// its header is read after that. Every object in the heap is marked, so a marked object on an evacuating
+// page has been moved, and stale references to dead ones are left alone.
+static inline Obj** forwardingSlot(Obj* object) {
+	return (Obj**)((char*)object + sizeof(Obj*));
+}
+
+static inline Obj* forward(Obj* object) {
+	if (object != NULL && heapIsEvacuating(object) && heapIsMarked(object)) return *forwardingSlot(object);
+	return object;
+}
+
+#define FORWARD(type, pointer) ((pointer) = (type*)forward((Obj*)(pointer)))
+
+static void forwardValue(Value* value) {
+	if (IS_OBJ(*value)) *value = OBJ_VAL(forward(AS_OBJ(*value)));
+}
+
+static void forwardArray(ValueArray* array) {
+	FORWARD(Obj, array->owner);
+	for (size_t i = 0; i < array->count; i++) {
+		forwardValue(&array->values[i]);
+	}
+}
+
+static void forwardEntries(Table* table) {
+	FORWARD(Obj, table->owner);
+	for (int i = 0; i <= table->capacity; i++) {
+		Entry* entry = &table->entries[i];
+		FORWARD(ObjString, entry->key);
+		forwardValue(&entry->value);
+	}
+}
+
+static void forwardValueEntries(ValueTable* table) {
+	FORWARD(Obj, table->owner);
+	for (int i = 0; i <= table->capacity; i++) {
+		if (!CTRL_IS_FULL(table->control[i])) continue;
+		ValueEntry* entry = &table->entries[i];
+		forwardValue(&entry->key);
+		forwardValue(&entry->value);
+	}
+}
+
+// Updates the references held by object, as blackenObject traces them.
+static void forwardReferences(Obj* object) {
+	switch (object->type) {
+		case OBJ_LIST:
+			forwardArray(&((ObjList*)object)->items);
+			break;
+		case OBJ_MAP:
+			forwardValueEntries(&((ObjMap*)object)->items);
+			break;
+		case OBJ_CLASS: {
+			ObjClass* klass = (ObjClass*)object;
+			FORWARD(ObjString, klass->name);
+			forwardEntries(&klass->methods);
+			break;
+		}
+		case OBJ_INSTANCE: {
+			ObjInstance* instance = (ObjInstance*)object;
+			FORWARD(ObjClass, instance->class);
+			forwardEntries(&instance->fields);
+			break;
+		}
+		case OBJ_BOUND_METHOD: {
+			ObjBoundMethod* bound = (ObjBoundMethod*)object;
+			forwardValue(&bound->receiver);
+			FORWARD(ObjClosure, bound->method);
+			break;
+		}
+		case OBJ_CLOSURE: {
+			ObjClosure* closure = (ObjClosure*)object;
+			FORWARD(ObjFunction, closure->function);
+			for (size_t i = 0; i < closure->upvalueCount; i++) {
+				FORWARD(ObjUpvalue, closure->upvalues[i]);
+			}
+			break;
+		}
+		case OBJ_FUNCTION: {
+			ObjFunction* function = (ObjFunction*)object;
+			FORWARD(ObjString, function->name);
+			forwardArray(&function->chunk.constants);
+			break;
+		}
+		case OBJ_UPVALUE: {
+			ObjUpvalue* upvalue = (ObjUpvalue*)object;
+			forwardValue(&upvalue->closed);
+			FORWARD(ObjUpvalue, upvalue->next);
+			break;
+		}
+		case OBJ_STRING: {
+			// A view of a string with inline chars points into it, so follows it when it moves.
+			ObjString* view = (ObjString*)object;
+			ObjString* parent = view->parent;
+			FORWARD(ObjString, view->parent);
+			if (view->parent != parent) view->chars = view->parent->chars + (view->chars - parent->chars);
+			break;
+		}
+		case OBJ_NATIVE:
+			// Natives are bound again before each call, but are updated so they never hold a released page.
+			forwardValue(&((ObjNative*)object)->bound);
+			break;
+		case OBJ_ARRAY:
+			break;
+	}
+}
+
+static void forwardRoots(VM* vm) {
+	for (Value* slot = vm->stack; slot < vm->stackTop; slot++) {
+		forwardValue(slot);
+	}
+
+	for (size_t i = 0; i < vm->frameCount; i++) {
+		FORWARD(ObjClosure, vm->frames[i].closure);
+	}
+
+	FORWARD(ObjUpvalue, vm->openUpvalues);
+
+	forwardEntries(&vm->strings);
+	for (size_t i = 0; i < vm->moduleCount; i++) {
+		Module* module = vm->modules[i];
+		forwardEntries(&module->globals);
+		forwardEntries(&module->imports);
+		FORWARD(ObjInstance, module->exports);
+		FORWARD(ObjString, module->filepath);
+	}
+
+	forwardEntries(&vm->loadedModules);
+	forwardEntries(&vm->builtins);
+	forwardEntries(&vm->stringMethods);
+	forwardEntries(&vm->listMethods);
+	forwardEntries(&vm->mapMethods);
+	forwardEntries(&vm->arrayMethods);
+	FORWARD(ObjString, vm->basePath);
+	FORWARD(ObjClass, vm->importClass);
+	FORWARD(ObjClass, vm->objectClass);
+	FORWARD(ObjClass, vm->iteratorClass);
+	FORWARD(ObjClass, vm->exceptionClass);
+}
+
+// Calls visit on each object on the pages which are, or are not, being evacuated, in address order within
+// each page. Pages allocated meanwhile are not visited.
+static void visitObjects(VM* vm, bool isEvacuating, void (*visit)(VM* vm, Obj* object)) {
+	for (HeapPage* page = vm->heap.pages; page != NULL; page = page->next) {
+		if (page->isEvacuating != isEvacuating) continue;
+
+		for (size_t i = 0; i < HEAP_MARK_WORDS; i++) {
+			size_t cells = page->cells[i];
+			for (size_t bit = 0; cells != 0; bit++, cells >>= 1) {
+				if ((cells & 1) != 0) visit(vm, heapCellAt(page, i, bit));
+			}
+		}
+	}
+}
+
+static void countLive(VM* vm, Obj* object) {
+	heapCountLive(object);
+}
+
+static void evacuateObject(VM* vm, Obj* object) {
+	size_t size = heapPageOf(object)->cellSize;
+	Obj* copy = heapAllocate(&vm->heap, size);
+	if (copy == NULL) {
+		fprintf(stderr, "Failed to reallocate memory.");
+		exit(1);
+	}
+	memcpy(copy, object, size);
+	heapSetMark(copy);
+
+	// Pointers into the object itself must point into the copy.
+	switch (object->type) {
+		case OBJ_UPVALUE: {
+			ObjUpvalue* upvalue = (ObjUpvalue*)object;
+			if (upvalue->location == &upvalue->closed) ((ObjUpvalue*)copy)->location = &((ObjUpvalue*)copy)->closed;
+			break;
+		}
+		case OBJ_STRING:
+			if (isInlineString((ObjString*)object)) ((ObjString*)copy)->chars = ((ObjString*)copy)->inlineChars;
+			break;
+		case OBJ_CLOSURE: {
+			ObjClosure* closure = (ObjClosure*)object;
+			if (closure->upvalues == closure->inlineUpvalues) ((ObjClosure*)copy)->upvalues = ((ObjClosure*)copy)->inlineUpvalues;
+			break;
+		}
+		case OBJ_LIST:
+			if (hasInlineValues(&((ObjList*)object)->items)) ((ObjList*)copy)->items.values = ((ObjList*)copy)->inlineItems;
+			break;
+	}
+
+	*forwardingSlot(object) = copy;
+}
+
+static void forwardObject(VM* vm, Obj* object) {
+	forwardReferences(object);
+}
+
+static void rehashObject(VM* vm, Obj* object) {
+	if (object->type == OBJ_MAP) valueTableRehash(vm, &((ObjMap*)object)->items);
+}
+
+// Evacuates the pages left sparse by the last full collection, so they can be released. The young
+// generation is collected first, leaving every object old and marked. Each object on an evacuated page
+// is copied out, and then every reference the VM can reach is updated to the copy. It waits until no
+// import is running, as the importer's C frames hold references the collector cannot update.
+void compactHeap(VM* vm) {
+	if (vm->gcPhase != GC_IDLE || vm->compiler != NULL || vm->baseFrame != 0) return;
+	vm->shouldCompact = false;
+
+	uint64_t start = currentNanos();
+	collectYoung(vm);
+
+	vm->isCollecting = true;
+
+	heapClearLive(&vm->heap);
+	visitObjects(vm, false, countLive);
+
+	if (!heapBeginEvacuation(&vm->heap, GC_COMPACT_OCCUPANCY)) {
+		vm->isCollecting = false;
+		return;
+	}
+	vm->gcStats.compactions++;
+
+	// Copies land on the pages which are kept, so are visited by the passes after this one.
+	visitObjects(vm, true, evacuateObject);
+
+	forwardRoots(vm);
+	visitObjects(vm, false, forwardObject);
+
+	// Only once every reference is updated, as a list key hashes by its items.
+	visitObjects(vm, false, rehashObject);
+
+	heapEndEvacuation(&vm->heap);
+
+	vm->isCollecting = false;
+
+	uint64_t elapsed = currentNanos() - start;
+	recordGCTime(&vm->gcStats, GC_TIME_COMPACT, elapsed);
+	recordGCTime(&vm->gcStats, GC_TIME_PAUSE, elapsed);
+}
+
 static void freeObject(VM* vm, Obj* object) {
 
 #ifdef FOX_DEBUG_LOG_GC
@@ -239,65 +1307,63 @@ static void freeObject(VM* vm, Obj* object) {
 		case OBJ_CLASS: {
 			ObjClass* klass = (ObjClass*)object;
 			freeTable(vm, &klass->methods);
-			FREE(vm, ObjClass, object);
 			break;
 		}
 
 		case OBJ_LIST: {
-			FREE(vm, ObjList, object);
+			ObjList* list = (ObjList*)object;
+			freeValueArray(vm, &list->items);
+			break;
+		}
+
+		case OBJ_MAP: {
+			ObjMap* map = (ObjMap*)object;
+			freeValueTable(vm, &map->items);
+			break;
+		}
+
+		case OBJ_ARRAY: {
+			ObjArray* array = (ObjArray*)object;
+			FREE_ARRAY(vm, uint8_t, array->data, arrayElementSize(array->arrayType) * array->count);
 			break;
 		}
 
 		case OBJ_INSTANCE: {
 			ObjInstance* instance = (ObjInstance*)object;
 			freeTable(vm, &instance->fields);
-			FREE(vm, ObjInstance, object);
 			break;
 		}
 
-		case OBJ_BOUND_METHOD:
-			FREE(vm, ObjBoundMethod, object);
-			break;
-
 		case OBJ_STRING: {
 			ObjString* string = (ObjString*)object;
-			FREE_ARRAY(vm, char, string->chars, string->length + 1);
-			FREE(vm, ObjString, object);
+			if (string->parent == NULL && !isInlineString(string)) FREE_ARRAY(vm, char, string->chars, string->length + 1);
 			break;
 		}
 
 		case OBJ_FUNCTION: {
 			ObjFunction* function = (ObjFunction*)object;
 			freeChunk(vm, &function->chunk);
-			FREE(vm, ObjFunction, object);
-			break;
-		}
-
-		case OBJ_NATIVE: {
-			FREE(vm, ObjNative, object);
 			break;
 		}
 
 		case OBJ_CLOSURE: {
 			ObjClosure* closure = (ObjClosure*)object;
-			FREE_ARRAY(vm, ObjUpvalue*, closure->upvalues, closure->upvalueCount);
-			FREE(vm, ObjClosure, object);
+			if (closure->upvalues != closure->inlineUpvalues) FREE_ARRAY(vm, ObjUpvalue*, closure->upvalues, closure->upvalueCount);
 			break;
 		}
 
-		case OBJ_UPVALUE: {
-			FREE(vm, ObjUpvalue, object);
+		// These own nothing outside their cell.
+		case OBJ_BOUND_METHOD:
+		case OBJ_NATIVE:
+		case OBJ_UPVALUE:
 			break;
-		}
 
 	}
+
+	freeCell(vm, object);
 }
 
 void freeObjects(VM* vm) {
-	Obj* object = vm->objects;
-	while (object != NULL) {
-		Obj* next = object->next;
-		freeObject(vm, object);
-		object = next;
-	}
+	visitObjects(vm, false, freeObject);
+	vm->youngCount = 0;
 }
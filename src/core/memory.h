@@ -5,13 +5,118 @@
 
 void* reallocate(VM* vm, void* pointer, size_t oldSize, size_t size);
 
+// Allocates an object of size bytes, at most HEAP_MAX_CELL, from the VM's heap.
+void* allocateCell(VM* vm, size_t size);
+
+void freeCell(VM* vm, void* cell);
+
+// The defaults of the settings in GCConfig.
+#define GC_INITIAL_HEAP (1024 * 1024)
+#define GC_HEAP_GROW_FACTOR 2
+#define GC_MIN_HEAP 0
+#define GC_MAX_HEAP 0
+
+// Bytes which may be allocated between collections before the young generation is collected. Larger
+// heaps use a nursery of bytesAllocated / GC_NURSERY_DIVISOR, up to GC_NURSERY_MAX when a pause target
+// is set.
+#define GC_NURSERY_SIZE (256 * 1024)
+#define GC_NURSERY_DIVISOR 4
+#define GC_NURSERY_MAX (2 * 1024 * 1024)
+
+// Marking for a full collection is split into slices of at most GC_PAUSE_TARGET microseconds, one after
+// each GC_STEP_SIZE bytes allocated, after which the old generation is swept lazily at the same steps.
+// The target can be overridden with the pause option, FOX_GC_PAUSE or --gc-pause. 0 marks all at once.
+#define GC_PAUSE_TARGET 1000
+#define GC_STEP_SIZE (64 * 1024)
+
+// Helper threads which mark alongside the VM's own during full collections. Can be overridden with the
+// threads option, FOX_GC_THREADS or --gc-threads.
+#define GC_MARK_THREADS 0
+
+// A full collection which leaves the heap's pages less than GC_COMPACT_OCCUPANCY percent used schedules a
+// compaction, which moves the objects out of the pages used less than that so they can be released.
+// Heaps smaller than GC_COMPACT_MIN_HEAP are left alone.
+#define GC_COMPACT_OCCUPANCY 50
+#define GC_COMPACT_MIN_HEAP (4 * 1024 * 1024)
+
+// The settings each VM's collector starts from, shared by the whole process. They are read from the
+// environment when first used, as FOX_GC_INITIAL_HEAP for the initial-heap option and so on, and command
+// line flags may then override them.
+typedef struct {
+	size_t initialHeap; // Bytes allocated before the first full collection.
+	double growFactor; // Each full collection runs once the heap has grown by this factor since the last.
+	size_t minHeap; // Full collections do not run on heaps smaller than this.
+	size_t maxHeap; // Full collections run before the heap grows past this, 0 for no limit.
+	size_t pauseTarget;
+	size_t markThreads;
+	const char* statsPath; // Where the root VM writes its GCStats as JSON when it is freed, - for stderr.
+	bool hugePages; // Backs the heap's regions with huge pages where the system allows, on or off.
+} GCConfig;
+
+GCConfig* gcConfig();
+
+// Sets an option by its flag name: initial-heap, growth, min-heap, max-heap, pause, threads, stats or
+// huge-pages. Sizes may have a K, M or G suffix. Returns false if the name or value is invalid.
+bool setGCOption(GCConfig* config, const char* name, const char* value);
+
+// Writes the VM's GCStats to the stats path, if one is set.
+void dumpGCStats(VM* vm);
+
+// Runs a full collection to completion, finishing one already in progress.
 void collectGarbage(VM* vm);
 
+void collectYoung(VM* vm);
+
+// Runs a compaction scheduled by the last full collection. Objects move, so this must only be called
+// where every reference to an object is one the collector can find, between instructions.
+void compactHeap(VM* vm);
+
 void freeObjects(VM* vm);
 
 void markValue(VM* vm, Value value);
 void markObject(VM* vm, Obj* object);
 void markTable(VM* vm, Table* table);
+void markValueTable(VM* vm, ValueTable* table);
+
+void rememberObject(VM* vm, Obj* object);
+
+void initMarker(Marker* marker, VM* vm);
+
+void freeMarker(Marker* marker);
+
+// Joins the helper threads started for parallel marking, if any.
+void stopMarkHelpers(VM* vm);
+
+// Must follow every store of a value into an object. An old object given a reference to a young one
+// is remembered, so that minor collections, which do not trace old objects, still find it.
+// While a full collection is marking, a value stored into an already marked object is marked too, as
+// the collector will not look at that object again.
+static inline void writeBarrier(VM* vm, Obj* owner, Value value) {
+	if (owner == NULL || !IS_OBJ(value)) return;
+	Obj* object = AS_OBJ(value);
+
+	if (owner->isOld && !owner->isRemembered && !object->isOld) rememberObject(vm, owner);
+	if (vm->gcPhase == GC_MARKING && heapIsMarked(owner)) markObject(vm, object);
+}
+
+// As writeBarrier, for a store into array at index. Minor collections only scan the dirty values of a
+// remembered list, so appending to a large old list does not rescan all of it each time.
+static inline void writeArrayBarrier(VM* vm, ValueArray* array, size_t index, Value value) {
+	Obj* owner = array->owner;
+	if (owner == NULL || !IS_OBJ(value)) return;
+	Obj* object = AS_OBJ(value);
+
+	if (owner->isOld && !object->isOld) {
+		if (index < array->dirty) array->dirty = index;
+		if (!owner->isRemembered) rememberObject(vm, owner);
+	}
+	if (vm->gcPhase == GC_MARKING && heapIsMarked(owner)) markObject(vm, object);
+}
+
+// Must follow moving values around within array, as young values may now sit before its dirty index.
+static inline void arrayValuesMoved(ValueArray* array) {
+	if (array->dirty != SIZE_MAX) array->dirty = 0;
+}
 
 #define ALLOCATE(vm, type, count) \
     (type*)reallocate(vm, NULL, 0, sizeof(type) * (count))
@@ -19,4 +124,4 @@ void markTable(VM* vm, Table* table);
 #define GROW_ARRAY(vm, type, pointer, oldSize, newSize) reallocate(vm, pointer, sizeof(type) * (oldSize), sizeof(type) * (newSize))
 
 #define FREE(vm, type, pointer) reallocate(vm, pointer, sizeof(type), 0)
-#define FREE_ARRAY(vm, type, pointer, length) reallocate(vm, pointer, sizeof(type) * (length), 0)
\ No newline at end of file
+#define FREE_ARRAY(vm, type, pointer, length) reallocate(vm, pointer, sizeof(type) * (length), 0)
@@ -0,0 +1,272 @@
+#include "number.h"
+#include <string.h>
+#include <math.h>
+
+// Shortest round-trip formatting using Grisu2 (Florian Loitsch, "Printing Floating-Point Numbers
+// Quickly and Accurately with Integers"). Grisu2 always round-trips, and is shortest for almost every input.
+
+#define DOUBLE_SIGNIFICAND_MASK 0x000FFFFFFFFFFFFFULL
+#define DOUBLE_EXPONENT_MASK 0x7FF0000000000000ULL
+#define DOUBLE_HIDDEN_BIT 0x0010000000000000ULL
+#define DOUBLE_EXPONENT_BIAS 1075 // 1023 + 52 significand bits
+
+// Integral values below this are printed with the integer fast path.
+#define INTEGER_FAST_PATH_LIMIT 9007199254740992.0 // 2^53
+
+// A floating point number f * 2^e with a 64 bit significand.
+typedef struct {
+	uint64_t f;
+	int e;
+} DiyFp;
+
+// Normalised 10^k for k = -348, -340, ..., 340.
+static const uint64_t cachedPowersF[] = {
+	0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL, 0xcf42894a5dce35eaULL,
+	0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL, 0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL,
+	0xbe5691ef416bd60cULL, 0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+	0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL, 0xc21094364dfb5637ULL,
+	0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL, 0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL,
+	0xb23867fb2a35b28eULL, 0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+	0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL, 0xb5b5ada8aaff80b8ULL,
+	0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL, 0x964e858c91ba2655ULL, 0xdff9772470297ebdULL,
+	0xa6dfbd9fb8e5b88fULL, 0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+	0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL, 0xaa242499697392d3ULL,
+	0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL, 0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL,
+	0x9c40000000000000ULL, 0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+	0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL, 0x9f4f2726179a2245ULL,
+	0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL, 0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL,
+	0x924d692ca61be758ULL, 0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+	0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL, 0x952ab45cfa97a0b3ULL,
+	0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL, 0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL,
+	0x88fcf317f22241e2ULL, 0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+	0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL, 0x8bab8eefb6409c1aULL,
+	0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL, 0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL,
+	0x80444b5e7aa7cf85ULL, 0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+	0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL
+};
+
+static const int16_t cachedPowersE[] = {
+	-1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927, -901, -874, -847, -821,
+	-794, -768, -741, -715, -688, -661, -635, -608, -582, -555, -529, -502, -475, -449, -422, -396,
+	-369, -343, -316, -289, -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30,
+	56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348, 375, 402, 428, 455,
+	481, 508, 534, 561, 588, 614, 641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+	907, 933, 960, 986, 1013, 1039, 1066
+};
+
+static const uint64_t powersOf10[] = {
+	1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL,
+	1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+	100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+	1000000000000000000ULL, 10000000000000000000ULL
+};
+
+// Upper 64 bits of the 128 bit product, rounded.
+static DiyFp multiply(DiyFp a, DiyFp b) {
+	const uint64_t mask = 0xFFFFFFFFULL;
+	uint64_t a0 = a.f & mask, a1 = a.f >> 32;
+	uint64_t b0 = b.f & mask, b1 = b.f >> 32;
+	uint64_t ac = a1 * b1, bc = a0 * b1, ad = a1 * b0, bd = a0 * b0;
+	uint64_t middle = (bd >> 32) + (ad & mask) + (bc & mask) + (1ULL << 31);
+	return (DiyFp){ ac + (ad >> 32) + (bc >> 32) + (middle >> 32), a.e + b.e + 64 };
+}
+
+static DiyFp normalize(DiyFp x) {
+	while (!(x.f & (1ULL << 63))) {
+		x.f <<= 1;
+		x.e--;
+	}
+	return x;
+}
+
+// Computes the normalised value and the boundaries halfway to its neighbours, sharing one exponent.
+static void boundaries(double value, DiyFp* v, DiyFp* minus, DiyFp* plus) {
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	int biased = (int)((bits & DOUBLE_EXPONENT_MASK) >> 52);
+	uint64_t significand = bits & DOUBLE_SIGNIFICAND_MASK;
+
+	DiyFp w;
+	if (biased != 0) w = (DiyFp){ significand + DOUBLE_HIDDEN_BIT, biased - DOUBLE_EXPONENT_BIAS };
+	else w = (DiyFp){ significand, 1 - DOUBLE_EXPONENT_BIAS };
+
+	DiyFp upper = normalize((DiyFp){ (w.f << 1) + 1, w.e - 1 });
+
+	// The gap below a power of two is half as wide.
+	DiyFp lower = w.f == DOUBLE_HIDDEN_BIT ? (DiyFp){ (w.f << 2) - 1, w.e - 2 } : (DiyFp){ (w.f << 1) - 1, w.e - 1 };
+	lower.f <<= lower.e - upper.e;
+	lower.e = upper.e;
+
+	*v = normalize(w);
+	*minus = lower;
+	*plus = upper;
+}
+
+// Finds c = 10^-k such that e + c.e + 64 lands in [-60, -32], and returns it with k.
+static DiyFp cachedPower(int e, int* k) {
+	double dk = (-61 - e) * 0.30102999566398114 + 347;
+	int ik = (int)dk;
+	if (dk - ik > 0.0) ik++;
+
+	unsigned index = (unsigned)((ik >> 3) + 1);
+	*k = -(-348 + (int)(index << 3));
+	return (DiyFp){ cachedPowersF[index], cachedPowersE[index] };
+}
+
+static int countDigits(uint32_t n) {
+	if (n < 10) return 1;
+	if (n < 100) return 2;
+	if (n < 1000) return 3;
+	if (n < 10000) return 4;
+	if (n < 100000) return 5;
+	if (n < 1000000) return 6;
+	if (n < 10000000) return 7;
+	if (n < 100000000) return 8;
+	return 9; // p1 never reaches 10 digits.
+}
+
+// Nudges the last digit towards the true value while it stays within the boundaries.
+static void roundWeed(char* digits, int length, uint64_t delta, uint64_t rest, uint64_t tenKappa, uint64_t distance) {
+	while (rest < distance && delta - rest >= tenKappa
+		&& (rest + tenKappa < distance || distance - rest > rest + tenKappa - distance)) {
+		digits[length - 1]--;
+		rest += tenKappa;
+	}
+}
+
+static void generateDigits(DiyFp w, DiyFp upper, uint64_t delta, char* digits, int* length, int* k) {
+	DiyFp one = { 1ULL << -upper.e, upper.e };
+	uint64_t distance = upper.f - w.f;
+
+	uint32_t p1 = (uint32_t)(upper.f >> -one.e);
+	uint64_t p2 = upper.f & (one.f - 1);
+	int kappa = countDigits(p1);
+	*length = 0;
+
+	while (kappa > 0) {
+		uint32_t divisor = (uint32_t)powersOf10[kappa - 1];
+		uint32_t d = p1 / divisor;
+		p1 %= divisor;
+
+		if (d || *length) digits[(*length)++] = (char)('0' + d);
+		kappa--;
+
+		uint64_t rest = ((uint64_t)p1 << -one.e) + p2;
+		if (rest <= delta) {
+			*k += kappa;
+			roundWeed(digits, *length, delta, rest, powersOf10[kappa] << -one.e, distance);
+			return;
+		}
+	}
+
+	for (;;) {
+		p2 *= 10;
+		delta *= 10;
+		char d = (char)(p2 >> -one.e);
+		if (d || *length) digits[(*length)++] = (char)('0' + d);
+		p2 &= one.f - 1;
+		kappa--;
+
+		if (p2 < delta) {
+			*k += kappa;
+			int index = -kappa;
+			roundWeed(digits, *length, delta, p2, one.f, distance * (index < 20 ? powersOf10[index] : 0));
+			return;
+		}
+	}
+}
+
+// Writes the shortest digits of a positive, finite value. The value is digits * 10^k.
+static int grisu2(double value, char* digits, int* k) {
+	DiyFp v, minus, plus;
+	boundaries(value, &v, &minus, &plus);
+
+	DiyFp c = cachedPower(plus.e, k);
+	DiyFp w = multiply(v, c);
+	DiyFp upper = multiply(plus, c);
+	DiyFp lower = multiply(minus, c);
+	lower.f++;
+	upper.f--;
+
+	int length;
+	generateDigits(w, upper, upper.f - lower.f, digits, &length, k);
+	return length;
+}
+
+static size_t writeInteger(uint64_t value, char* buffer) {
+	char reversed[20];
+	size_t length = 0;
+	do {
+		reversed[length++] = (char)('0' + value % 10);
+		value /= 10;
+	} while (value != 0);
+
+	for (size_t i = 0; i < length; i++) buffer[i] = reversed[length - 1 - i];
+	return length;
+}
+
+size_t formatNumber(double value, char* buffer) {
+	if (isnan(value)) {
+		memcpy(buffer, "nan", 3);
+		return 3;
+	}
+
+	char* start = buffer;
+	if (signbit(value)) {
+		*buffer++ = '-';
+		value = -value;
+	}
+
+	if (isinf(value)) {
+		memcpy(buffer, "inf", 3);
+		return (size_t)(buffer - start) + 3;
+	}
+
+	if (value < INTEGER_FAST_PATH_LIMIT && value == (double)(uint64_t)value) {
+		return (size_t)(buffer - start) + writeInteger((uint64_t)value, buffer);
+	}
+
+	char digits[18];
+	int k;
+	int length = grisu2(value, digits, &k);
+	int point = length + k; // The value is 0.digits * 10^point.
+
+	if (k >= 0 && point <= 21) {
+		// Integer: digits followed by zeros.
+		memcpy(buffer, digits, length);
+		memset(buffer + length, '0', k);
+		buffer += point;
+	}
+	else if (point > 0 && point <= 21) {
+		// Decimal point inside the digits.
+		memcpy(buffer, digits, point);
+		buffer[point] = '.';
+		memcpy(buffer + point + 1, digits + point, length - point);
+		buffer += length + 1;
+	}
+	else if (point > -6 && point <= 0) {
+		// Leading zeros after the decimal point.
+		buffer[0] = '0';
+		buffer[1] = '.';
+		memset(buffer + 2, '0', -point);
+		memcpy(buffer + 2 - point, digits, length);
+		buffer += 2 - point + length;
+	}
+	else {
+		// Scientific notation: d.ddde+x
+		*buffer++ = digits[0];
+		if (length > 1) {
+			*buffer++ = '.';
+			memcpy(buffer, digits + 1, length - 1);
+			buffer += length - 1;
+		}
+
+		int exponent = point - 1;
+		*buffer++ = 'e';
+		*buffer++ = exponent < 0 ? '-' : '+';
+		buffer += writeInteger((uint64_t)(exponent < 0 ? -exponent : exponent), buffer);
+	}
+
+	return (size_t)(buffer - start);
+}
\ No newline at end of file
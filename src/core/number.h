@@ -0,0 +1,9 @@
+#pragma once
+#include <core/common.h>
+#include <stddef.h>
+
+// Longest possible output of formatNumber: "-1.2345678901234567e-308" and a little headroom.
+#define NUMBER_BUFFER_SIZE 32
+
+// Writes the shortest string which reads back as exactly value. Not NUL terminated, returns the length.
+size_t formatNumber(double value, char* buffer);
\ No newline at end of file
@@ -0,0 +1,199 @@
+#include "thread.h"
+#include <core/common.h>
+#include <stdlib.h>
+
+typedef struct {
+	ThreadFn function;
+	void* argument;
+} ThreadStart;
+
+#if defined(_WIN32) || defined(_WIN64) || defined(WINDOWS)
+
+static DWORD WINAPI runThread(LPVOID start) {
+	ThreadStart thread = *(ThreadStart*)start;
+	free(start);
+	thread.function(thread.argument);
+	return 0;
+}
+
+bool startThread(Thread* thread, ThreadFn function, void* argument) {
+	ThreadStart* start = malloc(sizeof(ThreadStart));
+	if (start == NULL) return false;
+	start->function = function;
+	start->argument = argument;
+
+	*thread = CreateThread(NULL, 0, runThread, start, 0, NULL);
+	if (*thread == NULL) {
+		free(start);
+		return false;
+	}
+	return true;
+}
+
+void joinThread(Thread thread) {
+	WaitForSingleObject(thread, INFINITE);
+	CloseHandle(thread);
+}
+
+void initMutex(Mutex* mutex) {
+	InitializeSRWLock(mutex);
+}
+
+void freeMutex(Mutex* mutex) {
+	(void)mutex;
+}
+
+void lockMutex(Mutex* mutex) {
+	AcquireSRWLockExclusive(mutex);
+}
+
+void unlockMutex(Mutex* mutex) {
+	ReleaseSRWLockExclusive(mutex);
+}
+
+void initCondition(Condition* condition) {
+	InitializeConditionVariable(condition);
+}
+
+void freeCondition(Condition* condition) {
+	(void)condition;
+}
+
+void waitCondition(Condition* condition, Mutex* mutex) {
+	SleepConditionVariableSRW(condition, mutex, INFINITE, 0);
+}
+
+void broadcastCondition(Condition* condition) {
+	WakeAllConditionVariable(condition);
+}
+
+bool atomicLoadBool(bool* flag) {
+	return InterlockedOr8((volatile char*)flag, 0) != 0;
+}
+
+void atomicStoreBool(bool* flag, bool value) {
+	InterlockedExchange8((volatile char*)flag, value);
+}
+
+size_t atomicLoadSize(size_t* value) {
+	return (size_t)InterlockedCompareExchangePointer((void* volatile*)value, NULL, NULL);
+}
+
+void atomicStoreSize(size_t* value, size_t newValue) {
+	InterlockedExchangePointer((void* volatile*)value, (void*)newValue);
+}
+
+size_t atomicFetchOrSize(size_t* value, size_t bits) {
+#if defined(_WIN64)
+	return (size_t)InterlockedOr64((volatile LONG64*)value, (LONG64)bits);
+#else
+	return (size_t)InterlockedOr((volatile LONG*)value, (LONG)bits);
+#endif
+}
+
+uint64_t currentMicros() {
+	LARGE_INTEGER frequency, counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return (uint64_t)(counter.QuadPart / frequency.QuadPart * 1000000 + counter.QuadPart % frequency.QuadPart * 1000000 / frequency.QuadPart);
+}
+
+uint64_t currentNanos() {
+	LARGE_INTEGER frequency, counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return (uint64_t)(counter.QuadPart / frequency.QuadPart * 1000000000 + counter.QuadPart % frequency.QuadPart * 1000000000 / frequency.QuadPart);
+}
+
+#else
+#include <time.h>
+
+static void* runThread(void* start) {
+	ThreadStart thread = *(ThreadStart*)start;
+	free(start);
+	thread.function(thread.argument);
+	return NULL;
+}
+
+bool startThread(Thread* thread, ThreadFn function, void* argument) {
+	ThreadStart* start = malloc(sizeof(ThreadStart));
+	if (start == NULL) return false;
+	start->function = function;
+	start->argument = argument;
+
+	if (pthread_create(thread, NULL, runThread, start) != 0) {
+		free(start);
+		return false;
+	}
+	return true;
+}
+
+void joinThread(Thread thread) {
+	pthread_join(thread, NULL);
+}
+
+void initMutex(Mutex* mutex) {
+	pthread_mutex_init(mutex, NULL);
+}
+
+void freeMutex(Mutex* mutex) {
+	pthread_mutex_destroy(mutex);
+}
+
+void lockMutex(Mutex* mutex) {
+	pthread_mutex_lock(mutex);
+}
+
+void unlockMutex(Mutex* mutex) {
+	pthread_mutex_unlock(mutex);
+}
+
+void initCondition(Condition* condition) {
+	pthread_cond_init(condition, NULL);
+}
+
+void freeCondition(Condition* condition) {
+	pthread_cond_destroy(condition);
+}
+
+void waitCondition(Condition* condition, Mutex* mutex) {
+	pthread_cond_wait(condition, mutex);
+}
+
+void broadcastCondition(Condition* condition) {
+	pthread_cond_broadcast(condition);
+}
+
+bool atomicLoadBool(bool* flag) {
+	return __atomic_load_n(flag, __ATOMIC_RELAXED);
+}
+
+void atomicStoreBool(bool* flag, bool value) {
+	__atomic_store_n(flag, value, __ATOMIC_RELAXED);
+}
+
+size_t atomicLoadSize(size_t* value) {
+	return __atomic_load_n(value, __ATOMIC_RELAXED);
+}
+
+void atomicStoreSize(size_t* value, size_t newValue) {
+	__atomic_store_n(value, newValue, __ATOMIC_RELAXED);
+}
+
+size_t atomicFetchOrSize(size_t* value, size_t bits) {
+	return __atomic_fetch_or(value, bits, __ATOMIC_RELAXED);
+}
+
+uint64_t currentMicros() {
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return (uint64_t)time.tv_sec * 1000000 + (uint64_t)time.tv_nsec / 1000;
+}
+
+uint64_t currentNanos() {
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return (uint64_t)time.tv_sec * 1000000000 + (uint64_t)time.tv_nsec;
+}
+
+#endif
\ No newline at end of file
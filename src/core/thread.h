@@ -0,0 +1,55 @@
+#pragma once
+#include <core/common.h>
+#include <stddef.h>
+
+// A minimal wrapper over the platform's threads, for the collector's helper threads.
+#if defined(_WIN32) || defined(_WIN64) || defined(WINDOWS)
+#include <windows.h>
+typedef HANDLE Thread;
+typedef SRWLOCK Mutex;
+typedef CONDITION_VARIABLE Condition;
+#else
+#include <pthread.h>
+typedef pthread_t Thread;
+typedef pthread_mutex_t Mutex;
+typedef pthread_cond_t Condition;
+#endif
+
+typedef void (*ThreadFn)(void* argument);
+
+bool startThread(Thread* thread, ThreadFn function, void* argument);
+
+void joinThread(Thread thread);
+
+void initMutex(Mutex* mutex);
+
+void freeMutex(Mutex* mutex);
+
+void lockMutex(Mutex* mutex);
+
+void unlockMutex(Mutex* mutex);
+
+void initCondition(Condition* condition);
+
+void freeCondition(Condition* condition);
+
+void waitCondition(Condition* condition, Mutex* mutex);
+
+void broadcastCondition(Condition* condition);
+
+bool atomicLoadBool(bool* flag);
+
+void atomicStoreBool(bool* flag, bool value);
+
+size_t atomicLoadSize(size_t* value);
+
+void atomicStoreSize(size_t* value, size_t newValue);
+
+// Sets bits in value, returning its previous value.
+size_t atomicFetchOrSize(size_t* value, size_t bits);
+
+// A monotonic clock, in microseconds.
+uint64_t currentMicros();
+
+// The same clock, in nanoseconds, for timing short collector phases.
+uint64_t currentNanos();
\ No newline at end of file
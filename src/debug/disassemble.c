@@ -18,7 +18,7 @@ size_t getLine(LineNumberTable* table, size_t index) {
 }
 
 void disassembleChunk(VM* vm, Chunk* chunk, const char* name) {
-	printf("=== %s | %s ===\n", vm->filename, name);
+	printf("=== %s | %s ===\n", vm->module->filename, name);
 
 	size_t offset = 0;
 
@@ -8,6 +8,10 @@
 #include <string.h>
 #include <signal.h>
 #include <core/file.h>
+#include <core/buffer.h>
+#include <core/memory.h>
+#include <compiler/bytecode.h>
+#include <vm/snapshot.h>
 
 // The below variable and function allows the user to exit with Ctrl-C
 static volatile sig_atomic_t replKeepRunning = 1;
@@ -28,7 +32,9 @@ static void repl() {
 	strcpy(scriptName, "<script>");
 
 	while (replKeepRunning) {
+		flushOutput();
 		printf(">>> ");
+		fflush(stdout);
 
 		char* line = inputString(stdin, 30);
 
@@ -38,7 +44,8 @@ static void repl() {
 	freeVM(&vm);
 }
 
-static void runFile(const char* path) {
+// Splits path into the directory imports are resolved against, ending in a separator, and the file's name.
+static void splitPath(const char* path, char** base, char** name) {
 	size_t length = strlen(path);
 	char* slashRoot = malloc(length + 1);
 	strcpy(slashRoot, path);
@@ -47,60 +54,137 @@ static void runFile(const char* path) {
 
 	char* lastInstance = fromLastInstance(slashRoot, "/");
 
-	char* base;
-	char* name;
-
 	if (lastInstance != NULL) {
 		size_t index = lastInstance - slashRoot;
 
-		base = malloc(index + 2);
-		memcpy(base, slashRoot, index);
-		base[index] = '/';
-		base[index + 1] = '\0';
+		*base = malloc(index + 2);
+		memcpy(*base, slashRoot, index);
+		(*base)[index] = '/';
+		(*base)[index + 1] = '\0';
 
-		name = malloc(strlen(lastInstance));
-		strcpy(name, lastInstance + 1);
+		*name = malloc(strlen(lastInstance));
+		strcpy(*name, lastInstance + 1);
 	}
 	else {
 		char buffer[FILENAME_MAX];
 		getCurrentDir(buffer, FILENAME_MAX);
 
-		base = malloc(strlen(buffer) + 2);
-		strcpy(base, buffer);
-		base[strlen(buffer)] = '/';
-		base[strlen(buffer) + 1] = '\0';
+		*base = malloc(strlen(buffer) + 2);
+		strcpy(*base, buffer);
+		(*base)[strlen(buffer)] = '/';
+		(*base)[strlen(buffer) + 1] = '\0';
 
-		name = malloc(strlen(slashRoot) + 1);
-		strcpy(name, slashRoot);
+		*name = malloc(strlen(slashRoot) + 1);
+		strcpy(*name, slashRoot);
 	}
 
+	free(slashRoot);
+}
+
+static char* readSource(const char* path) {
 	File file = readFile(path);
-	char* source = file.contents;
 	if (file.isError) {
 		fprintf(stderr, "%s\n", file.contents);
 		exit(-4);
 	}
+	return file.contents;
+}
+
+static void runFile(const char* path) {
+	char* base;
+	char* name;
+	splitPath(path, &base, &name);
+
+	char* source = readSource(path);
 
 	InterpreterResult result = interpret(base, name, source);
 	free(source);
 	free(base);
-	free(slashRoot);
 
 	if (result == STATUS_COMPILE_ERR) exit(-2);
 	if (result == STATUS_RUNTIME_ERR) exit(-3);
 
 }
 
+// Runs each prelude in turn as the main script, then saves the globals they define to an image which
+// later runs can start from instead.
+static void makeSnapshot(const char* imagePath, int count, const char** preludes) {
+	VM vm;
+	initVM(&vm, "main");
+
+	for (int i = 0; i < count; i++) {
+		char* base;
+		char* name;
+		splitPath(preludes[i], &base, &name);
+
+		char* source = readSource(preludes[i]);
+
+		InterpreterResult result = interpretVM(&vm, base, name, source);
+		free(source);
+		free(base);
+
+		if (result == STATUS_COMPILE_ERR) exit(-2);
+		if (result == STATUS_RUNTIME_ERR) exit(-3);
+	}
+
+	bool isWritten = writeSnapshot(&vm, imagePath);
+	freeVM(&vm);
+	if (!isWritten) exit(-5);
+}
+
+static void usage() {
+	fprintf(stderr, "Usage: fox [--gc-<option>=<value>...] [--cache=<off|directory>] [--snapshot=<image>] [filepath]\n");
+	fprintf(stderr, "       fox [options] --make-snapshot=<image> [prelude...]\n");
+	fprintf(stderr, "GC options: initial-heap, growth, min-heap, max-heap, pause, threads, stats, huge-pages\n");
+}
+
+// Applies a --gc-<option>=<value> flag, returning false if it is not one.
+static bool gcFlag(const char* arg) {
+	if (strncmp(arg, "--gc-", 5) != 0) return false;
+
+	const char* separator = strchr(arg, '=');
+	if (separator == NULL) return false;
+
+	char name[32];
+	size_t length = separator - (arg + 5);
+	if (length >= sizeof(name)) return false;
+	memcpy(name, arg + 5, length);
+	name[length] = '\0';
+
+	return setGCOption(gcConfig(), name, separator + 1);
+}
+
 int main(int argc, const char** argv) {
+	atexit(flushOutput);
+
+	const char* imagePath = NULL;
+
+	int arg = 1;
+	for (; arg < argc && strncmp(argv[arg], "--", 2) == 0; arg++) {
+		if (strncmp(argv[arg], "--cache=", 8) == 0 && setBytecodeCache(argv[arg] + 8)) continue;
+		if (strncmp(argv[arg], "--snapshot=", 11) == 0 && setStartupSnapshot(argv[arg] + 11)) continue;
+		if (strncmp(argv[arg], "--make-snapshot=", 16) == 0 && argv[arg][16] != '\0') {
+			imagePath = argv[arg] + 16;
+			continue;
+		}
+		if (!gcFlag(argv[arg])) {
+			fprintf(stderr, "Invalid option '%s'.\n", argv[arg]);
+			usage();
+			return -1;
+		}
+	}
 
-	if (argc == 1) {
+	if (imagePath != NULL) {
+		makeSnapshot(imagePath, argc - arg, argv + arg);
+	}
+	else if (arg == argc) {
 		repl();
 	}
-	else if (argc == 2) {
-		runFile(argv[1]);
+	else if (arg + 1 == argc) {
+		runFile(argv[arg]);
 	}
 	else {
-		fprintf(stderr, "Usage: fox [filepath]\n");
+		usage();
 		return -1;
 	}
 
@@ -0,0 +1,413 @@
+#include "array.h"
+#include <vm/vm.h>
+#include <string.h>
+#include <math.h>
+
+// Float64 kernels use the widest vectors the compiler targets, other element types use plain loops.
+#if defined(__AVX__)
+#include <immintrin.h>
+#define LANES 4
+typedef __m256d Lanes;
+#define lanesLoad(p) _mm256_loadu_pd(p)
+#define lanesStore(p, v) _mm256_storeu_pd(p, v)
+#define lanesSet(x) _mm256_set1_pd(x)
+#define lanesAdd(a, b) _mm256_add_pd(a, b)
+#define lanesMul(a, b) _mm256_mul_pd(a, b)
+#define lanesMin(a, b) _mm256_min_pd(a, b)
+#define lanesMax(a, b) _mm256_max_pd(a, b)
+#define lanesLess(a, b) _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_LT_OQ))
+#define lanesGreater(a, b) _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_GT_OQ))
+#define lanesEqual(a, b) _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_EQ_OQ))
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LANES 2
+typedef __m128d Lanes;
+#define lanesLoad(p) _mm_loadu_pd(p)
+#define lanesStore(p, v) _mm_storeu_pd(p, v)
+#define lanesSet(x) _mm_set1_pd(x)
+#define lanesAdd(a, b) _mm_add_pd(a, b)
+#define lanesMul(a, b) _mm_mul_pd(a, b)
+#define lanesMin(a, b) _mm_min_pd(a, b)
+#define lanesMax(a, b) _mm_max_pd(a, b)
+#define lanesLess(a, b) _mm_movemask_pd(_mm_cmplt_pd(a, b))
+#define lanesGreater(a, b) _mm_movemask_pd(_mm_cmpgt_pd(a, b))
+#define lanesEqual(a, b) _mm_movemask_pd(_mm_cmpeq_pd(a, b))
+#else
+#define LANES 1
+typedef double Lanes;
+#define lanesLoad(p) (*(p))
+#define lanesStore(p, v) (*(p) = (v))
+#define lanesSet(x) (x)
+#define lanesAdd(a, b) ((a) + (b))
+#define lanesMul(a, b) ((a) * (b))
+#define lanesMin(a, b) ((a) < (b) ? (a) : (b))
+#define lanesMax(a, b) ((a) > (b) ? (a) : (b))
+#define lanesLess(a, b) ((a) < (b))
+#define lanesGreater(a, b) ((a) > (b))
+#define lanesEqual(a, b) ((a) == (b))
+#endif
+
+typedef enum {
+	COMPARE_LESS,
+	COMPARE_GREATER,
+	COMPARE_EQUAL
+} CompareOp;
+
+typedef enum {
+	ELEMENT_ADD,
+	ELEMENT_MUL
+} ElementOp;
+
+static double lanesReduceAdd(Lanes v) {
+	double lanes[LANES];
+	lanesStore(lanes, v);
+	double result = 0;
+	for (int i = 0; i < LANES; i++) result += lanes[i];
+	return result;
+}
+
+static double sumF64(const double* a, size_t count) {
+	Lanes acc0 = lanesSet(0);
+	Lanes acc1 = lanesSet(0);
+
+	// Two accumulators hide the latency of the adds.
+	size_t i = 0;
+	for (; i + 2 * LANES <= count; i += 2 * LANES) {
+		acc0 = lanesAdd(acc0, lanesLoad(&a[i]));
+		acc1 = lanesAdd(acc1, lanesLoad(&a[i + LANES]));
+	}
+
+	double sum = lanesReduceAdd(lanesAdd(acc0, acc1));
+	for (; i < count; i++) sum += a[i];
+	return sum;
+}
+
+static double dotF64(const double* a, const double* b, size_t count) {
+	Lanes acc0 = lanesSet(0);
+	Lanes acc1 = lanesSet(0);
+
+	size_t i = 0;
+	for (; i + 2 * LANES <= count; i += 2 * LANES) {
+		acc0 = lanesAdd(acc0, lanesMul(lanesLoad(&a[i]), lanesLoad(&b[i])));
+		acc1 = lanesAdd(acc1, lanesMul(lanesLoad(&a[i + LANES]), lanesLoad(&b[i + LANES])));
+	}
+
+	double sum = lanesReduceAdd(lanesAdd(acc0, acc1));
+	for (; i < count; i++) sum += a[i] * b[i];
+	return sum;
+}
+
+// count must be non-zero.
+static double extremeF64(const double* a, size_t count, bool max) {
+	Lanes acc = lanesSet(a[0]);
+
+	size_t i = 0;
+	for (; i + LANES <= count; i += LANES) {
+		acc = max ? lanesMax(acc, lanesLoad(&a[i])) : lanesMin(acc, lanesLoad(&a[i]));
+	}
+
+	double lanes[LANES];
+	lanesStore(lanes, acc);
+	double result = lanes[0];
+	for (int lane = 1; lane < LANES; lane++) {
+		result = max ? (lanes[lane] > result ? lanes[lane] : result) : (lanes[lane] < result ? lanes[lane] : result);
+	}
+	for (; i < count; i++) {
+		result = max ? (a[i] > result ? a[i] : result) : (a[i] < result ? a[i] : result);
+	}
+	return result;
+}
+
+// b is either an array of count elements, or NULL to use the scalar k for every element.
+static void elementwiseF64(ElementOp op, double* dst, const double* a, const double* b, double k, size_t count) {
+	Lanes scalar = lanesSet(k);
+
+	size_t i = 0;
+	for (; i + LANES <= count; i += LANES) {
+		Lanes y = b == NULL ? scalar : lanesLoad(&b[i]);
+		lanesStore(&dst[i], op == ELEMENT_ADD ? lanesAdd(lanesLoad(&a[i]), y) : lanesMul(lanesLoad(&a[i]), y));
+	}
+
+	for (; i < count; i++) {
+		double y = b == NULL ? k : b[i];
+		dst[i] = op == ELEMENT_ADD ? a[i] + y : a[i] * y;
+	}
+}
+
+static void compareF64(CompareOp op, uint8_t* dst, const double* a, const double* b, double k, size_t count) {
+	Lanes scalar = lanesSet(k);
+
+	size_t i = 0;
+	for (; i + LANES <= count; i += LANES) {
+		Lanes x = lanesLoad(&a[i]);
+		Lanes y = b == NULL ? scalar : lanesLoad(&b[i]);
+
+		int mask;
+		switch (op) {
+			case COMPARE_LESS: mask = lanesLess(x, y); break;
+			case COMPARE_GREATER: mask = lanesGreater(x, y); break;
+			default: mask = lanesEqual(x, y); break;
+		}
+
+		for (int lane = 0; lane < LANES; lane++) {
+			dst[i + lane] = (mask >> lane) & 1;
+		}
+	}
+
+	for (; i < count; i++) {
+		double y = b == NULL ? k : b[i];
+		switch (op) {
+			case COMPARE_LESS: dst[i] = a[i] < y; break;
+			case COMPARE_GREATER: dst[i] = a[i] > y; break;
+			default: dst[i] = a[i] == y; break;
+		}
+	}
+}
+
+static double arraySum(ObjArray* array) {
+	switch (array->arrayType) {
+		case ARRAY_FLOAT64: return sumF64(array->f64, array->count);
+		case ARRAY_INT32: {
+			int64_t sum = 0;
+			for (size_t i = 0; i < array->count; i++) sum += array->i32[i];
+			return (double)sum;
+		}
+		case ARRAY_UINT8: {
+			uint64_t sum = 0;
+			for (size_t i = 0; i < array->count; i++) sum += array->u8[i];
+			return (double)sum;
+		}
+	}
+	return 0; // Unreachable
+}
+
+static Value makeArray(VM* vm, ArrayType type, size_t argCount, Value* args, bool* hasError) {
+	if (argCount != 1) {
+		*hasError = !throwException(vm, "ArityException", "Expected 1 argument but got %d.", (int)argCount);
+		return pop(vm);
+	}
+
+	if (IS_NUMBER(args[0])) {
+		// Checked before the cast to size_t, which is undefined for values it cannot hold.
+		double length = AS_NUMBER(args[0]);
+		if (!isfinite(length) || length < 0 || trunc(length) != length) {
+			*hasError = !throwException(vm, "TypeException", "Expected array length to be a non-negative integer.");
+			return pop(vm);
+		}
+		if (length >= (double)(SIZE_MAX / arrayElementSize(type))) {
+			*hasError = !throwException(vm, "RangeException", "Array length is too large.");
+			return pop(vm);
+		}
+		return OBJ_VAL(newArray(vm, type, (size_t)length));
+	}
+
+	if (IS_LIST(args[0])) {
+		ValueArray* items = &AS_LIST(args[0])->items;
+		for (size_t i = 0; i < items->count; i++) {
+			if (!IS_NUMBER(items->values[i])) {
+				*hasError = !throwException(vm, "TypeException", "Expected list to only contain numbers.");
+				return pop(vm);
+			}
+		}
+
+		ObjArray* array = newArray(vm, type, items->count);
+		for (size_t i = 0; i < items->count; i++) {
+			arraySet(array, i, AS_NUMBER(items->values[i]));
+		}
+		return OBJ_VAL(array);
+	}
+
+	*hasError = !throwException(vm, "TypeException", "Expected first parameter to be a length or a list of numbers.");
+	return pop(vm);
+}
+
+Value float64ArrayNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	return makeArray(vm, ARRAY_FLOAT64, argCount, args, hasError);
+}
+
+Value int32ArrayNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	return makeArray(vm, ARRAY_INT32, argCount, args, hasError);
+}
+
+Value uint8ArrayNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	return makeArray(vm, ARRAY_UINT8, argCount, args, hasError);
+}
+
+// Checks the operand of an element-wise method is a number, or an array the same length as the receiver.
+static bool checkOperand(VM* vm, ObjArray* array, Value operand, bool* hasError) {
+	if (IS_NUMBER(operand)) return true;
+
+	if (!IS_ARRAY(operand)) {
+		*hasError = !throwException(vm, "TypeException", "Expected first parameter to be a number or an array.");
+		return false;
+	}
+
+	if (AS_ARRAY(operand)->count != array->count) {
+		*hasError = !throwException(vm, "InvalidOperationException", "Array lengths differ (%d and %d).", (int)array->count, (int)AS_ARRAY(operand)->count);
+		return false;
+	}
+
+	return true;
+}
+
+static Value elementwise(VM* vm, ElementOp op, Value* args, Value* bound, bool* hasError) {
+	ObjArray* array = AS_ARRAY(*bound);
+	if (!checkOperand(vm, array, args[0], hasError)) return pop(vm);
+
+	ObjArray* result = newArray(vm, array->arrayType, array->count);
+
+	if (array->arrayType == ARRAY_FLOAT64 && (IS_NUMBER(args[0]) || AS_ARRAY(args[0])->arrayType == ARRAY_FLOAT64)) {
+		const double* other = IS_NUMBER(args[0]) ? NULL : AS_ARRAY(args[0])->f64;
+		elementwiseF64(op, result->f64, array->f64, other, IS_NUMBER(args[0]) ? AS_NUMBER(args[0]) : 0, array->count);
+		return OBJ_VAL(result);
+	}
+
+	for (size_t i = 0; i < array->count; i++) {
+		double y = IS_NUMBER(args[0]) ? AS_NUMBER(args[0]) : arrayGet(AS_ARRAY(args[0]), i);
+		double x = arrayGet(array, i);
+		arraySet(result, i, op == ELEMENT_ADD ? x + y : x * y);
+	}
+	return OBJ_VAL(result);
+}
+
+static Value compare(VM* vm, CompareOp op, Value* args, Value* bound, bool* hasError) {
+	ObjArray* array = AS_ARRAY(*bound);
+	if (!checkOperand(vm, array, args[0], hasError)) return pop(vm);
+
+	ObjArray* mask = newArray(vm, ARRAY_UINT8, array->count);
+
+	if (array->arrayType == ARRAY_FLOAT64 && (IS_NUMBER(args[0]) || AS_ARRAY(args[0])->arrayType == ARRAY_FLOAT64)) {
+		const double* other = IS_NUMBER(args[0]) ? NULL : AS_ARRAY(args[0])->f64;
+		compareF64(op, mask->u8, array->f64, other, IS_NUMBER(args[0]) ? AS_NUMBER(args[0]) : 0, array->count);
+		return OBJ_VAL(mask);
+	}
+
+	for (size_t i = 0; i < array->count; i++) {
+		double y = IS_NUMBER(args[0]) ? AS_NUMBER(args[0]) : arrayGet(AS_ARRAY(args[0]), i);
+		double x = arrayGet(array, i);
+		switch (op) {
+			case COMPARE_LESS: mask->u8[i] = x < y; break;
+			case COMPARE_GREATER: mask->u8[i] = x > y; break;
+			default: mask->u8[i] = x == y; break;
+		}
+	}
+	return OBJ_VAL(mask);
+}
+
+Value arrayLengthNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	return NUMBER_VAL((double)AS_ARRAY(*bound)->count);
+}
+
+Value arraySumNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	return NUMBER_VAL(arraySum(AS_ARRAY(*bound)));
+}
+
+static Value extreme(ObjArray* array, bool max) {
+	if (array->count == 0) return NULL_VAL;
+
+	if (array->arrayType == ARRAY_FLOAT64) return NUMBER_VAL(extremeF64(array->f64, array->count, max));
+
+	double result = arrayGet(array, 0);
+	for (size_t i = 1; i < array->count; i++) {
+		double x = arrayGet(array, i);
+		if (max ? x > result : x < result) result = x;
+	}
+	return NUMBER_VAL(result);
+}
+
+Value arrayMinNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	return extreme(AS_ARRAY(*bound), false);
+}
+
+Value arrayMaxNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	return extreme(AS_ARRAY(*bound), true);
+}
+
+Value arrayDotNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	ObjArray* array = AS_ARRAY(*bound);
+	if (!checkOperand(vm, array, args[0], hasError)) return pop(vm);
+
+	if (!IS_ARRAY(args[0])) {
+		*hasError = !throwException(vm, "TypeException", "Expected first parameter to be an array.");
+		return pop(vm);
+	}
+
+	ObjArray* other = AS_ARRAY(args[0]);
+	if (array->arrayType == ARRAY_FLOAT64 && other->arrayType == ARRAY_FLOAT64) {
+		return NUMBER_VAL(dotF64(array->f64, other->f64, array->count));
+	}
+
+	double sum = 0;
+	for (size_t i = 0; i < array->count; i++) {
+		sum += arrayGet(array, i) * arrayGet(other, i);
+	}
+	return NUMBER_VAL(sum);
+}
+
+Value arrayAddNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	return elementwise(vm, ELEMENT_ADD, args, bound, hasError);
+}
+
+Value arrayMulNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	return elementwise(vm, ELEMENT_MUL, args, bound, hasError);
+}
+
+Value arrayScaleNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	if (!IS_NUMBER(args[0])) {
+		*hasError = !throwException(vm, "TypeException", "Expected first parameter to be a number.");
+		return pop(vm);
+	}
+	return elementwise(vm, ELEMENT_MUL, args, bound, hasError);
+}
+
+Value arrayLessNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	return compare(vm, COMPARE_LESS, args, bound, hasError);
+}
+
+Value arrayGreaterNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	return compare(vm, COMPARE_GREATER, args, bound, hasError);
+}
+
+Value arrayEqualNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	return compare(vm, COMPARE_EQUAL, args, bound, hasError);
+}
+
+Value arrayToListNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	ObjArray* array = AS_ARRAY(*bound);
+
+	ValueArray items;
+	initValueArray(&items);
+	for (size_t i = 0; i < array->count; i++) {
+		writeValueArray(vm, &items, NUMBER_VAL(arrayGet(array, i)));
+	}
+
+	return OBJ_VAL(newList(vm, items));
+}
+
+Value arrayIteratorNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	ObjInstance* inst = newInstance(vm, vm->iteratorClass);
+	push(vm, OBJ_VAL(inst));
+
+	tableSet(vm, &inst->fields, copyString(vm, "index", 5), NUMBER_VAL(0));
+
+	tableSet(vm, &inst->fields, copyString(vm, "data", 4), *bound);
+
+	pop(vm);
+	return OBJ_VAL(inst);
+}
+
+void defineArrayMethods(VM* vm) {
+	defineNative(vm, &vm->arrayMethods, "length", arrayLengthNative, 0, false);
+	defineNative(vm, &vm->arrayMethods, "sum", arraySumNative, 0, false);
+	defineNative(vm, &vm->arrayMethods, "min", arrayMinNative, 0, false);
+	defineNative(vm, &vm->arrayMethods, "max", arrayMaxNative, 0, false);
+	defineNative(vm, &vm->arrayMethods, "dot", arrayDotNative, 1, false);
+	defineNative(vm, &vm->arrayMethods, "add", arrayAddNative, 1, false);
+	defineNative(vm, &vm->arrayMethods, "mul", arrayMulNative, 1, false);
+	defineNative(vm, &vm->arrayMethods, "scale", arrayScaleNative, 1, false);
+	defineNative(vm, &vm->arrayMethods, "less", arrayLessNative, 1, false);
+	defineNative(vm, &vm->arrayMethods, "greater", arrayGreaterNative, 1, false);
+	defineNative(vm, &vm->arrayMethods, "equal", arrayEqualNative, 1, false);
+	defineNative(vm, &vm->arrayMethods, "toList", arrayToListNative, 0, false);
+	defineNative(vm, &vm->arrayMethods, "iterator", arrayIteratorNative, 0, false);
+}
\ No newline at end of file
@@ -0,0 +1,10 @@
+#pragma once
+#include "globals.h"
+
+Value float64ArrayNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError);
+
+Value int32ArrayNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError);
+
+Value uint8ArrayNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError);
+
+void defineArrayMethods(VM* vm);
\ No newline at end of file
@@ -16,39 +16,31 @@ Value exceptionGetStackTrace(VM* vm, size_t argCount, Value* args, Value* bound,
 
 	ValueArray stackTrace = AS_LIST(stackTraceValue)->items;
 
-	char* string = NULL;
-
-	Value value;
-	char* valueString = "\0";
-	if (tableGet(fields, copyString(vm, "value", 5), &value)) {
-		valueString = valueToString(vm, value);
-	}
+	Buffer buffer;
+	initBuffer(&buffer);
 
 	Value name;
-	char* nameString = NULL;
-	if (tableGet(fields, copyString(vm, "name", 4), &name)) {
-		nameString = valueToString(vm, name);
-	}
+	if (tableGet(fields, copyString(vm, "name", 4), &name)) writeValue(vm, &buffer, name);
+	else bufferWriteString(&buffer, "Exception");
+	bufferWrite(&buffer, ": ", 2);
 
-	Value filename;
-	char* filenameString = "<missing field>";
-	if (tableGet(fields, copyString(vm, "filename", 8), &filename)) {
-		filenameString = valueToString(vm, filename);
-	}
-
-	size_t size = snprintf(NULL, 0, "%s: %s\nIn file %s:", nameString == NULL ? "Exception" : nameString, valueString, filenameString);
+	Value value;
+	if (tableGet(fields, copyString(vm, "value", 5), &value)) writeValue(vm, &buffer, value);
 
-	string = malloc(size + 1);
-	sprintf(string, "%s: %s\nIn file %s:", nameString == NULL ? "Exception" : nameString, valueString, filenameString);
+	bufferWriteString(&buffer, "\nIn file ");
+	Value filename;
+	if (tableGet(fields, copyString(vm, "filename", 8), &filename)) writeValue(vm, &buffer, filename);
+	else bufferWriteString(&buffer, "<missing field>");
+	bufferWriteChar(&buffer, ':');
 
 	for (size_t i = 0; i < stackTrace.count; i++) {
-		size_t lineSize = snprintf(NULL, 0, "\n%s", AS_CSTRING(stackTrace.values[i]));
-		string = realloc(string, size + lineSize + 1);
-		sprintf(string + size, "\n%s", AS_CSTRING(stackTrace.values[i]));
-		size += lineSize;
+		bufferWriteChar(&buffer, '\n');
+		writeValue(vm, &buffer, stackTrace.values[i]);
 	}
 
-	return OBJ_VAL(takeString(vm, string, size));
+	ObjString* string = copyString(vm, buffer.chars, buffer.length);
+	freeBuffer(&buffer);
+	return OBJ_VAL(string);
 }
 
 void defineExceptionMethods(VM* vm, ObjClass* klass) {
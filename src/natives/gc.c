@@ -0,0 +1,139 @@
+#include "gc.h"
+#include <vm/vm.h>
+#include <core/memory.h>
+#include <string.h>
+#include <math.h>
+
+// gc.collect()
+static Value gcCollectNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	collectGarbage(vm);
+	return NULL_VAL;
+}
+
+static void setStat(VM* vm, ObjMap* map, const char* name, Value value) {
+	push(vm, OBJ_VAL(copyString(vm, name, strlen(name))));
+	valueTableSet(vm, &map->items, peek(vm, 0), value);
+	pop(vm);
+}
+
+static ObjMap* pushMap(VM* vm) {
+	ObjMap* map = newMap(vm);
+	push(vm, OBJ_VAL(map));
+	return map;
+}
+
+static ObjList* pushList(VM* vm) {
+	ValueArray items;
+	initValueArray(&items);
+	ObjList* list = newList(vm, items);
+	push(vm, OBJ_VAL(list));
+	return list;
+}
+
+// Sets the map or list on top of the stack as a stat, and pops it.
+static void setStatPopped(VM* vm, ObjMap* map, const char* name) {
+	setStat(vm, map, name, peek(vm, 0));
+	pop(vm);
+}
+
+static double micros(uint64_t nanos) {
+	return (double)nanos / 1000;
+}
+
+// A Map of count, totalMicros, maxMicros and histogram, where histogram[i] counts the times under 2^i
+// microseconds and the last counts every longer one.
+static void setTimeStats(VM* vm, ObjMap* times, GCTimer timer) {
+	GCHistogram* histogram = &vm->gcStats.times[timer];
+	ObjMap* map = pushMap(vm);
+
+	setStat(vm, map, "count", NUMBER_VAL((double)histogram->count));
+	setStat(vm, map, "totalMicros", NUMBER_VAL(micros(histogram->total)));
+	setStat(vm, map, "maxMicros", NUMBER_VAL(micros(histogram->max)));
+
+	ObjList* buckets = pushList(vm);
+	for (int i = 0; i < GC_HISTOGRAM_BUCKETS; i++) {
+		writeValueArray(vm, &buckets->items, NUMBER_VAL((double)histogram->buckets[i]));
+	}
+	setStatPopped(vm, map, "histogram");
+
+	setStatPopped(vm, times, gcTimerName(timer));
+}
+
+static const char* phaseName(GCPhase phase) {
+	switch (phase) {
+		case GC_IDLE: return "idle";
+		case GC_MARKING: return "marking";
+		case GC_SWEEPING: return "sweeping";
+	}
+	return NULL; // Unreachable.
+}
+
+// gc.stats() -> Map of the collector's state, settings and telemetry. Times are in microseconds, and
+// heapHistory holds the heap size left by each of the last full collections, oldest first.
+static Value gcStatsNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	ObjMap* map = pushMap(vm);
+
+	setStat(vm, map, "bytesAllocated", NUMBER_VAL((double)vm->bytesAllocated));
+	setStat(vm, map, "heapBytes", NUMBER_VAL((double)(vm->heap.pageCount * HEAP_PAGE_SIZE)));
+	setStat(vm, map, "threshold", NUMBER_VAL((double)vm->nextGC));
+	setStat(vm, map, "fullCollections", NUMBER_VAL((double)vm->gcStats.fullCycles));
+	setStat(vm, map, "minorCollections", NUMBER_VAL((double)vm->gcStats.minorCycles));
+	setStat(vm, map, "compactions", NUMBER_VAL((double)vm->gcStats.compactions));
+	setStat(vm, map, "bytesFreed", NUMBER_VAL((double)vm->gcStats.bytesFreed));
+
+	ObjMap* freed = pushMap(vm);
+	for (int i = 0; i < OBJ_TYPE_COUNT; i++) {
+		setStat(vm, freed, objTypeName((ObjType)i), NUMBER_VAL((double)vm->gcStats.objectsFreed[i]));
+	}
+	setStatPopped(vm, map, "objectsFreed");
+
+	ObjMap* times = pushMap(vm);
+	for (int i = 0; i < GC_TIME_COUNT; i++) {
+		setTimeStats(vm, times, (GCTimer)i);
+	}
+	setStatPopped(vm, map, "times");
+
+	size_t sizes[GC_HEAP_HISTORY];
+	size_t count = gcHeapHistory(&vm->gcStats, sizes);
+	ObjList* history = pushList(vm);
+	for (size_t i = 0; i < count; i++) {
+		writeValueArray(vm, &history->items, NUMBER_VAL((double)sizes[i]));
+	}
+	setStatPopped(vm, map, "heapHistory");
+
+	const char* phase = phaseName(vm->gcPhase);
+	push(vm, OBJ_VAL(copyString(vm, phase, strlen(phase))));
+	setStat(vm, map, "phase", peek(vm, 0));
+	pop(vm);
+
+	setStat(vm, map, "growFactor", NUMBER_VAL(vm->gcGrowFactor));
+	setStat(vm, map, "minHeap", NUMBER_VAL((double)vm->gcMinHeap));
+	setStat(vm, map, "maxHeap", NUMBER_VAL((double)vm->gcMaxHeap));
+	setStat(vm, map, "pauseTarget", NUMBER_VAL((double)vm->gcPauseTarget));
+
+	return pop(vm);
+}
+
+// gc.setThreshold(bytes), the heap size at which the next full collection starts.
+static Value gcSetThresholdNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	if (!IS_NUMBER(args[0]) || isnan(AS_NUMBER(args[0])) || AS_NUMBER(args[0]) < 0) {
+		*hasError = !throwException(vm, "TypeException", "Expected first parameter to be a non-negative number.");
+		return pop(vm);
+	}
+
+	// Thresholds too large for size_t, Infinity among them, saturate rather than being cast.
+	double threshold = AS_NUMBER(args[0]);
+	vm->nextGC = threshold < (double)SIZE_MAX ? (size_t)threshold : SIZE_MAX;
+	return NULL_VAL;
+}
+
+void defineGCModule(VM* vm) {
+	ObjInstance* module = newInstance(vm, vm->importClass);
+	push(vm, OBJ_VAL(module));
+	tableSet(vm, &vm->builtins, copyString(vm, "gc", 2), peek(vm, 0));
+	pop(vm);
+
+	defineNative(vm, &module->fields, "collect", gcCollectNative, 0, false);
+	defineNative(vm, &module->fields, "stats", gcStatsNative, 0, false);
+	defineNative(vm, &module->fields, "setThreshold", gcSetThresholdNative, 1, false);
+}
\ No newline at end of file
@@ -0,0 +1,5 @@
+#pragma once
+#include "globals.h"
+
+// Defines the gc global, a module object giving scripts control over the collector.
+void defineGCModule(VM* vm);
\ No newline at end of file
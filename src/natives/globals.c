@@ -1,6 +1,9 @@
 #include "globals.h"
 #include <vm/vm.h>
+#include <natives/map.h>
+#include <natives/array.h>
 #include <core/file.h>
+#include <core/buffer.h>
 #include <string.h>
 #include <time.h>
 #include <math.h>
@@ -30,12 +33,12 @@ static Value sqrtNative(VM* vm, size_t argCount, Value* args, Value* bound, bool
 }
 
 static Value inputNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	Buffer* output = outputBuffer();
 	for (size_t i = 0; i < argCount; i++) {
-		char* rep = valueToString(vm, args[i]);
-		printf("%s", rep);
-		free(rep);
-		if (i != argCount - 1) printf(" ");
+		writeValue(vm, output, args[i]);
+		if (i != argCount - 1) bufferWriteChar(output, ' ');
 	}
+	flushOutput(); // The prompt must be visible before blocking on stdin.
 
 	char* input = inputString(stdin, 20);
 	return OBJ_VAL(takeString(vm, input, strlen(input)));
@@ -46,7 +49,7 @@ static Value readNative(VM* vm, size_t argCount, Value* args, Value* bound, bool
 		*hasError = !throwException(vm, "TypeException", "Expected first parameter to be a string.");
 		return pop(vm);
 	}
-	File file = readFile(AS_CSTRING(args[0]));
+	File file = readFile(internString(vm, AS_STRING(args[0]))->chars);
 	if (file.isError) {
 		*hasError = !throwException(vm, "IOException", file.contents);
 		free(file.contents);
@@ -56,21 +59,31 @@ static Value readNative(VM* vm, size_t argCount, Value* args, Value* bound, bool
 }
 
 static Value printNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	Buffer* output = outputBuffer();
 	for (size_t i = 0; i < argCount; i++) {
-		char* rep = valueToString(vm, args[i]);
-		printf("%s", rep);
-		free(rep);
-		if (i != argCount - 1) printf(" ");
+		writeValue(vm, output, args[i]);
+		if (i != argCount - 1) bufferWriteChar(output, ' ');
 	}
-	printf("\n");
+	bufferWriteChar(output, '\n');
+	outputWritten();
 
 	return NULL_VAL;
 }
 
+static Value flushNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	flushOutput();
+	return NULL_VAL;
+}
+
 void defineGlobalVariables(VM* vm) {
-	defineNative(vm, &vm->globals, "clock", clockNative, 0, false);
-	defineNative(vm, &vm->globals, "sqrt", sqrtNative, 1, false);
-	defineNative(vm, &vm->globals, "input", inputNative, 0, true);
-	defineNative(vm, &vm->globals, "read", readNative, 1, false);
-	defineNative(vm, &vm->globals, "print", printNative, 0, true);
+	defineNative(vm, &vm->builtins, "clock", clockNative, 0, false);
+	defineNative(vm, &vm->builtins, "sqrt", sqrtNative, 1, false);
+	defineNative(vm, &vm->builtins, "input", inputNative, 0, true);
+	defineNative(vm, &vm->builtins, "read", readNative, 1, false);
+	defineNative(vm, &vm->builtins, "print", printNative, 0, true);
+	defineNative(vm, &vm->builtins, "flush", flushNative, 0, false);
+	defineNative(vm, &vm->builtins, "Map", mapNative, 0, true);
+	defineNative(vm, &vm->builtins, "Float64Array", float64ArrayNative, 0, true);
+	defineNative(vm, &vm->builtins, "Int32Array", int32ArrayNative, 0, true);
+	defineNative(vm, &vm->builtins, "Uint8Array", uint8ArrayNative, 0, true);
 }
\ No newline at end of file
@@ -67,8 +67,19 @@ Value iteratorNext(VM* vm, size_t argCount, Value* args, Value* bound, bool* has
 
 		returnValue = OBJ_VAL(copyString(vm, &string->chars[index], 1));
 	}
+	else if (IS_ARRAY(data)) {
+
+		ObjArray* array = AS_ARRAY(data);
+
+		if (index >= array->count) {
+			*hasError = !throwException(vm, "InvalidIndexException", "Iterator object's 'index' cannot be larger than the length (%d >= %d).", (int)index, (int)array->count);
+			return pop(vm);
+		}
+
+		returnValue = NUMBER_VAL(arrayGet(array, index));
+	}
 	else {
-		*hasError = !throwException(vm, "TypeException", "Iterator object's 'data' must be a list or a string.");
+		*hasError = !throwException(vm, "TypeException", "Iterator object's 'data' must be a list, a string or an array.");
 		return pop(vm);
 	}
 
@@ -107,8 +118,11 @@ Value iteratorDone(VM* vm, size_t argCount, Value* args, Value* bound, bool* has
 	else if (IS_STRING(data)) {
 		return BOOL_VAL(index >= AS_STRING(data)->length);
 	}
+	else if (IS_ARRAY(data)) {
+		return BOOL_VAL(index >= AS_ARRAY(data)->count);
+	}
 	else {
-		*hasError = !throwException(vm, "TypeException", "Iterator object's 'data' must be a list or a string.");
+		*hasError = !throwException(vm, "TypeException", "Iterator object's 'data' must be a list, a string or an array.");
 		return pop(vm);
 	}
 }
@@ -1,7 +1,10 @@
 #include "list.h"
 #include <vm/vm.h>
 #include <vm/opcodes.h>
+#include <core/memory.h>
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
 
 Value listLengthNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
 	return NUMBER_VAL((double)AS_LIST(*bound)->items.count);
@@ -12,18 +15,308 @@ Value listAppendNative(VM* vm, size_t argCount, Value* args, Value* bound, bool*
 	return NULL_VAL;
 }
 
+// Resolves a possibly negative integer index. allowEnd permits index == count, for insertion and slicing.
+static bool resolveIndex(VM* vm, Value value, size_t count, bool allowEnd, size_t* index, bool* hasError) {
+	if (!IS_NUMBER(value) || ceil(AS_NUMBER(value)) != AS_NUMBER(value)) {
+		*hasError = !throwException(vm, "InvalidIndexException", "Can only index a list using an integer.");
+		return false;
+	}
+
+	double dindex = AS_NUMBER(value);
+	if (dindex < 0) dindex += (double)count;
+
+	if (dindex < 0 || dindex > (double)count || (!allowEnd && dindex == (double)count)) {
+		*hasError = !throwException(vm, "IndexOutOfBoundsException", "Index is out of bounds for list length.");
+		return false;
+	}
+
+	*index = (size_t)dindex;
+	return true;
+}
+
+// Clamps a possibly negative slice bound into [0, count].
+static size_t clampIndex(double index, size_t count) {
+	if (index < 0) index += (double)count;
+	if (index < 0) return 0;
+	if (index > (double)count) return count;
+	return (size_t)index;
+}
+
+Value listSliceNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	if (argCount > 2) {
+		*hasError = !throwException(vm, "ArityException", "Expected 1 or 2 arguments but got %d.", (int)argCount);
+		return pop(vm);
+	}
+
+	for (size_t i = 0; i < argCount; i++) {
+		if (!IS_NUMBER(args[i]) || ceil(AS_NUMBER(args[i])) != AS_NUMBER(args[i])) {
+			*hasError = !throwException(vm, "TypeException", "Expected slice bounds to be integers.");
+			return pop(vm);
+		}
+	}
+
+	ValueArray* items = &AS_LIST(*bound)->items;
+	size_t start = clampIndex(AS_NUMBER(args[0]), items->count);
+	size_t end = argCount == 2 ? clampIndex(AS_NUMBER(args[1]), items->count) : items->count;
+
+	ValueArray slice;
+	initValueArray(&slice);
+	if (end > start) {
+		reserveValueArray(vm, &slice, end - start);
+		memcpy(slice.values, &items->values[start], sizeof(Value) * (end - start));
+		slice.count = end - start;
+	}
+
+	return OBJ_VAL(newList(vm, slice));
+}
+
+Value listExtendNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	if (!IS_LIST(args[0])) {
+		*hasError = !throwException(vm, "TypeException", "Expected first parameter to be a list.");
+		return pop(vm);
+	}
+
+	ValueArray* items = &AS_LIST(*bound)->items;
+	ValueArray* other = &AS_LIST(args[0])->items;
+	size_t count = other->count; // other may be items itself, so read the count before growing.
+
+	reserveValueArray(vm, items, items->count + count);
+	memcpy(&items->values[items->count], other->values, sizeof(Value) * count);
+	for (size_t i = 0; i < count; i++) {
+		writeArrayBarrier(vm, items, items->count + i, other->values[i]);
+	}
+	items->count += count;
+
+	return NULL_VAL;
+}
+
+Value listInsertNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	ValueArray* items = &AS_LIST(*bound)->items;
+
+	size_t index;
+	if (!resolveIndex(vm, args[0], items->count, true, &index, hasError)) return pop(vm);
+
+	insertValueArray(vm, items, index, args[1]);
+	return NULL_VAL;
+}
+
+Value listPopNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	if (argCount > 1) {
+		*hasError = !throwException(vm, "ArityException", "Expected 0 or 1 arguments but got %d.", (int)argCount);
+		return pop(vm);
+	}
+
+	ValueArray* items = &AS_LIST(*bound)->items;
+
+	if (items->count == 0) {
+		*hasError = !throwException(vm, "IndexOutOfBoundsException", "Cannot pop from an empty list.");
+		return pop(vm);
+	}
+
+	size_t index = items->count - 1;
+	if (argCount == 1 && !resolveIndex(vm, args[0], items->count, false, &index, hasError)) return pop(vm);
+
+	return removeValueArray(items, index);
+}
+
+Value listRemoveNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	ValueArray* items = &AS_LIST(*bound)->items;
+
+	for (size_t i = 0; i < items->count; i++) {
+		if (valuesEqual(items->values[i], args[0])) {
+			removeValueArray(items, i);
+			return BOOL_VAL(true);
+		}
+	}
+
+	return BOOL_VAL(false);
+}
+
+Value listReverseNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	ValueArray* items = &AS_LIST(*bound)->items;
+
+	for (size_t i = 0, j = items->count; i + 1 < j; i++, j--) {
+		Value temp = items->values[i];
+		items->values[i] = items->values[j - 1];
+		items->values[j - 1] = temp;
+	}
+	arrayValuesMoved(items);
+
+	return NULL_VAL;
+}
+
+Value listIndexOfNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	ValueArray* items = &AS_LIST(*bound)->items;
+
+	for (size_t i = 0; i < items->count; i++) {
+		if (valuesEqual(items->values[i], args[0])) return NUMBER_VAL((double)i);
+	}
+
+	return NUMBER_VAL(-1);
+}
+
+Value listClearNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	AS_LIST(*bound)->items.count = 0;
+	return NULL_VAL;
+}
+
+Value listReserveNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	// Checked before the cast to size_t, which is undefined for values it cannot hold.
+	double capacity = IS_NUMBER(args[0]) ? AS_NUMBER(args[0]) : -1;
+	if (!isfinite(capacity) || capacity < 0 || trunc(capacity) != capacity) {
+		*hasError = !throwException(vm, "TypeException", "Expected first parameter to be a non-negative integer.");
+		return pop(vm);
+	}
+	if (capacity >= (double)(SIZE_MAX / sizeof(Value))) {
+		*hasError = !throwException(vm, "RangeException", "List capacity is too large.");
+		return pop(vm);
+	}
+
+	reserveValueArray(vm, &AS_LIST(*bound)->items, (size_t)capacity);
+	return NULL_VAL;
+}
+
+// Below this many elements partitions are finished with an insertion sort.
+#define INSERTION_SORT_THRESHOLD 16
+
+// Numbers sort ascending with NaN last; strings sort bytewise.
+static inline bool sortLess(Value a, Value b, bool numbers) {
+	if (numbers) {
+		double x = AS_NUMBER(a);
+		double y = AS_NUMBER(b);
+		return x < y || (y != y && x == x);
+	}
+
+	ObjString* x = AS_STRING(a);
+	ObjString* y = AS_STRING(b);
+	int cmp = memcmp(x->chars, y->chars, x->length < y->length ? x->length : y->length);
+	return cmp < 0 || (cmp == 0 && x->length < y->length);
+}
+
+static inline void swapValues(Value* values, size_t a, size_t b) {
+	Value temp = values[a];
+	values[a] = values[b];
+	values[b] = temp;
+}
+
+static void insertionSort(Value* values, size_t count, bool numbers) {
+	for (size_t i = 1; i < count; i++) {
+		Value value = values[i];
+		size_t j = i;
+		while (j > 0 && sortLess(value, values[j - 1], numbers)) {
+			values[j] = values[j - 1];
+			j--;
+		}
+		values[j] = value;
+	}
+}
+
+static void siftDown(Value* values, size_t root, size_t count, bool numbers) {
+	for (;;) {
+		size_t child = 2 * root + 1;
+		if (child >= count) return;
+		if (child + 1 < count && sortLess(values[child], values[child + 1], numbers)) child++;
+		if (!sortLess(values[root], values[child], numbers)) return;
+		swapValues(values, root, child);
+		root = child;
+	}
+}
+
+static void heapSort(Value* values, size_t count, bool numbers) {
+	for (size_t i = count / 2; i > 0; i--) siftDown(values, i - 1, count, numbers);
+
+	for (size_t end = count - 1; end > 0; end--) {
+		swapValues(values, 0, end);
+		siftDown(values, 0, end, numbers);
+	}
+}
+
+// Quicksort with a median of three pivot, falling back to heapsort when the recursion gets too deep.
+static void introSort(Value* values, size_t count, int depth, bool numbers) {
+	while (count > INSERTION_SORT_THRESHOLD) {
+		if (depth-- == 0) {
+			heapSort(values, count, numbers);
+			return;
+		}
+
+		size_t mid = count / 2;
+		if (sortLess(values[mid], values[0], numbers)) swapValues(values, mid, 0);
+		if (sortLess(values[count - 1], values[0], numbers)) swapValues(values, count - 1, 0);
+		if (sortLess(values[count - 1], values[mid], numbers)) swapValues(values, count - 1, mid);
+		Value pivot = values[mid];
+
+		// Hoare partition: [0, j] <= pivot <= [j + 1, count).
+		size_t i = 0;
+		size_t j = count - 1;
+		for (;;) {
+			while (sortLess(values[i], pivot, numbers)) i++;
+			while (sortLess(pivot, values[j], numbers)) j--;
+			if (i >= j) break;
+			swapValues(values, i, j);
+			i++;
+			j--;
+		}
+
+		// Recurse into the smaller half so the stack stays logarithmic.
+		size_t left = j + 1;
+		if (left < count - left) {
+			introSort(values, left, depth, numbers);
+			values += left;
+			count -= left;
+		}
+		else {
+			introSort(values + left, count - left, depth, numbers);
+			count = left;
+		}
+	}
+
+	insertionSort(values, count, numbers);
+}
+
+Value listSortNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	ValueArray* items = &AS_LIST(*bound)->items;
+	if (items->count < 2) return NULL_VAL;
+
+	bool numbers = IS_NUMBER(items->values[0]);
+	for (size_t i = 0; i < items->count; i++) {
+		if (numbers ? !IS_NUMBER(items->values[i]) : !IS_STRING(items->values[i])) {
+			*hasError = !throwException(vm, "TypeException", "Can only sort lists containing only numbers or only strings.");
+			return pop(vm);
+		}
+	}
+
+	int depth = 0;
+	for (size_t n = items->count; n > 1; n >>= 1) depth += 2;
+
+	introSort(items->values, items->count, depth, numbers);
+	arrayValuesMoved(items);
+	return NULL_VAL;
+}
+
 Value listIteratorNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
 	ObjInstance* inst = newInstance(vm, vm->iteratorClass);
+	push(vm, OBJ_VAL(inst));
 
 	tableSet(vm, &inst->fields, copyString(vm, "index", 5), NUMBER_VAL(0));
 
 	tableSet(vm, &inst->fields, copyString(vm, "data", 4), *bound);
 
+	pop(vm);
 	return OBJ_VAL(inst);
 }
 
 void defineListMethods(VM* vm) {
 	defineNative(vm, &vm->listMethods, "length", listLengthNative, 0, false);
 	defineNative(vm, &vm->listMethods, "append", listAppendNative, 1, false);
+	defineNative(vm, &vm->listMethods, "slice", listSliceNative, 1, true);
+	defineNative(vm, &vm->listMethods, "extend", listExtendNative, 1, false);
+	defineNative(vm, &vm->listMethods, "insert", listInsertNative, 2, false);
+	defineNative(vm, &vm->listMethods, "pop", listPopNative, 0, true);
+	defineNative(vm, &vm->listMethods, "remove", listRemoveNative, 1, false);
+	defineNative(vm, &vm->listMethods, "reverse", listReverseNative, 0, false);
+	defineNative(vm, &vm->listMethods, "indexOf", listIndexOfNative, 1, false);
+	defineNative(vm, &vm->listMethods, "clear", listClearNative, 0, false);
+	defineNative(vm, &vm->listMethods, "reserve", listReserveNative, 1, false);
+	defineNative(vm, &vm->listMethods, "sort", listSortNative, 0, false);
 	defineNative(vm, &vm->listMethods, "iterator", listIteratorNative, 0, false);
 }
\ No newline at end of file
@@ -0,0 +1,112 @@
+#include "map.h"
+#include <vm/vm.h>
+
+// Throws, returning false, for a key which cannot be hashed.
+static bool checkKey(VM* vm, Value key, bool* hasError) {
+	if (isHashable(key)) return true;
+	*hasError = !throwException(vm, "TypeException", "Map keys cannot be lists which contain themselves or nest over %d deep.", KEY_DEPTH_MAX);
+	return false;
+}
+
+// Map(key, value, key, value, ...)
+Value mapNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	if (argCount % 2 != 0) {
+		*hasError = !throwException(vm, "ArityException", "Expected key-value pairs but got %d arguments.", (int)argCount);
+		return pop(vm);
+	}
+
+	for (size_t i = 0; i < argCount; i += 2) {
+		if (!checkKey(vm, args[i], hasError)) return pop(vm);
+	}
+
+	ObjMap* map = newMap(vm);
+	push(vm, OBJ_VAL(map));
+
+	for (size_t i = 0; i < argCount; i += 2) {
+		if (IS_STRING_VIEW(args[i])) args[i] = OBJ_VAL(internString(vm, AS_STRING(args[i])));
+		valueTableSet(vm, &map->items, args[i], args[i + 1]);
+	}
+
+	return pop(vm);
+}
+
+Value mapLengthNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	return NUMBER_VAL((double)AS_MAP(*bound)->items.count);
+}
+
+Value mapGetNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	if (!checkKey(vm, args[0], hasError)) return pop(vm);
+
+	Value value;
+	if (!valueTableGet(&AS_MAP(*bound)->items, args[0], &value)) return NULL_VAL;
+	return value;
+}
+
+Value mapSetNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	if (!checkKey(vm, args[0], hasError)) return pop(vm);
+
+	// Keys are interned so they do not keep a view's parent alive.
+	if (IS_STRING_VIEW(args[0])) args[0] = OBJ_VAL(internString(vm, AS_STRING(args[0])));
+	valueTableSet(vm, &AS_MAP(*bound)->items, args[0], args[1]);
+	return NULL_VAL;
+}
+
+Value mapHasNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	if (!checkKey(vm, args[0], hasError)) return pop(vm);
+
+	Value value;
+	return BOOL_VAL(valueTableGet(&AS_MAP(*bound)->items, args[0], &value));
+}
+
+Value mapDeleteNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	if (!checkKey(vm, args[0], hasError)) return pop(vm);
+	return BOOL_VAL(valueTableDelete(&AS_MAP(*bound)->items, args[0]));
+}
+
+static ObjList* mapEntries(VM* vm, ObjMap* map, bool keys) {
+	ValueArray array;
+	initValueArray(&array);
+
+	ValueTable* items = &map->items;
+	for (int i = 0; i <= items->capacity; i++) {
+		if (!CTRL_IS_FULL(items->control[i])) continue;
+		writeValueArray(vm, &array, keys ? items->entries[i].key : items->entries[i].value);
+	}
+
+	return newList(vm, array);
+}
+
+Value mapKeysNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	return OBJ_VAL(mapEntries(vm, AS_MAP(*bound), true));
+}
+
+Value mapValuesNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	return OBJ_VAL(mapEntries(vm, AS_MAP(*bound), false));
+}
+
+// Iterates over a snapshot of the keys.
+Value mapIteratorNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	push(vm, OBJ_VAL(mapEntries(vm, AS_MAP(*bound), true)));
+
+	ObjInstance* inst = newInstance(vm, vm->iteratorClass);
+	push(vm, OBJ_VAL(inst));
+
+	tableSet(vm, &inst->fields, copyString(vm, "index", 5), NUMBER_VAL(0));
+
+	tableSet(vm, &inst->fields, copyString(vm, "data", 4), peek(vm, 1));
+
+	pop(vm);
+	pop(vm);
+	return OBJ_VAL(inst);
+}
+
+void defineMapMethods(VM* vm) {
+	defineNative(vm, &vm->mapMethods, "length", mapLengthNative, 0, false);
+	defineNative(vm, &vm->mapMethods, "get", mapGetNative, 1, false);
+	defineNative(vm, &vm->mapMethods, "set", mapSetNative, 2, false);
+	defineNative(vm, &vm->mapMethods, "has", mapHasNative, 1, false);
+	defineNative(vm, &vm->mapMethods, "delete", mapDeleteNative, 1, false);
+	defineNative(vm, &vm->mapMethods, "keys", mapKeysNative, 0, false);
+	defineNative(vm, &vm->mapMethods, "values", mapValuesNative, 0, false);
+	defineNative(vm, &vm->mapMethods, "iterator", mapIteratorNative, 0, false);
+}
\ No newline at end of file
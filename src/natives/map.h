@@ -0,0 +1,6 @@
+#pragma once
+#include "globals.h"
+
+Value mapNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError);
+
+void defineMapMethods(VM* vm);
\ No newline at end of file
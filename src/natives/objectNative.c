@@ -42,7 +42,7 @@ Value objectHasPropNative(VM* vm, size_t argCount, Value* args, Value* bound, bo
 	}
 
 	Value v;
-	return BOOL_VAL(tableGet(&AS_INSTANCE(*bound)->fields, AS_STRING(args[0]), &v));
+	return BOOL_VAL(tableGet(&AS_INSTANCE(*bound)->fields, internString(vm, AS_STRING(args[0])), &v));
 }
 
 void defineObjectMethods(VM* vm, ObjClass* klass) {
@@ -1,21 +1,389 @@
 #include "string.h"
 #include <vm/vm.h>
+#include <core/memory.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FOX_STRING_SSE2
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static inline int firstBit(uint32_t mask) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return (int)index;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+// Returns the index of the first occurrence of needle, or STRING_NOT_FOUND. Lengths are explicit, so NUL bytes are ordinary characters.
+size_t findSubstring(const char* haystack, size_t length, const char* needle, size_t needleLength) {
+	if (needleLength == 0) return 0;
+	if (needleLength > length) return STRING_NOT_FOUND;
+
+	if (needleLength == 1) {
+		const char* found = memchr(haystack, needle[0], length);
+		return found == NULL ? STRING_NOT_FOUND : (size_t)(found - haystack);
+	}
+
+	size_t last = length - needleLength; // Last position the needle can start at.
+	size_t i = 0;
+
+#ifdef FOX_STRING_SSE2
+	// Compare the needle's first and last bytes against 16 candidate positions at once, and only memcmp where both match.
+	__m128i first = _mm_set1_epi8(needle[0]);
+	__m128i final = _mm_set1_epi8(needle[needleLength - 1]);
+
+	for (; i + 16 <= last + 1; i += 16) {
+		__m128i start = _mm_loadu_si128((const __m128i*)(haystack + i));
+		__m128i end = _mm_loadu_si128((const __m128i*)(haystack + i + needleLength - 1));
+		uint32_t match = (uint32_t)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(start, first), _mm_cmpeq_epi8(end, final)));
+
+		while (match) {
+			size_t candidate = i + firstBit(match);
+			if (memcmp(haystack + candidate + 1, needle + 1, needleLength - 2) == 0) return candidate;
+			match &= match - 1;
+		}
+	}
+#endif
+
+	while (i <= last) {
+		const char* found = memchr(haystack + i, needle[0], last - i + 1);
+		if (found == NULL) return STRING_NOT_FOUND;
+
+		i = (size_t)(found - haystack);
+		if (memcmp(haystack + i + 1, needle + 1, needleLength - 1) == 0) return i;
+		i++;
+	}
+
+	return STRING_NOT_FOUND;
+}
+
+// Copies length bytes from chars, flipping the case of ASCII letters in [from, from + 25].
+static void convertCase(char* dest, const char* chars, size_t length, char from) {
+	size_t i = 0;
+
+#ifdef FOX_STRING_SSE2
+	__m128i low = _mm_set1_epi8(from - 1);
+	__m128i high = _mm_set1_epi8(from + 26);
+	__m128i flip = _mm_set1_epi8(0x20);
+
+	// Bytes above 0x7F compare as negative, so they are never classified as letters.
+	for (; i + 16 <= length; i += 16) {
+		__m128i bytes = _mm_loadu_si128((const __m128i*)(chars + i));
+		__m128i letters = _mm_and_si128(_mm_cmpgt_epi8(bytes, low), _mm_cmplt_epi8(bytes, high));
+		_mm_storeu_si128((__m128i*)(dest + i), _mm_xor_si128(bytes, _mm_and_si128(letters, flip)));
+	}
+#endif
+
+	for (; i < length; i++) {
+		char c = chars[i];
+		dest[i] = c >= from && c <= from + 25 ? c ^ 0x20 : c;
+	}
+}
+
+static inline bool isWhitespace(char c) {
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+static bool expectString(VM* vm, Value value, const char* parameter, bool* hasError) {
+	if (IS_STRING(value)) return true;
+	*hasError = !throwException(vm, "TypeException", "Expected %s parameter to be a string.", parameter);
+	return false;
+}
 
 Value stringLengthNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
 	return NUMBER_VAL((double)AS_STRING(*bound)->length);
 }
 
+Value stringIndexOfNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	if (argCount > 2) {
+		*hasError = !throwException(vm, "ArityException", "Expected 1 or 2 arguments but got %d.", (int)argCount);
+		return pop(vm);
+	}
+	if (!expectString(vm, args[0], "first", hasError)) return pop(vm);
+
+	ObjString* string = AS_STRING(*bound);
+	ObjString* needle = AS_STRING(args[0]);
+
+	size_t start = 0;
+	if (argCount == 2) {
+		if (!IS_NUMBER(args[1]) || AS_NUMBER(args[1]) < 0 || ceil(AS_NUMBER(args[1])) != AS_NUMBER(args[1])) {
+			*hasError = !throwException(vm, "TypeException", "Expected second parameter to be a non-negative integer.");
+			return pop(vm);
+		}
+		if (AS_NUMBER(args[1]) > (double)string->length) return NUMBER_VAL(-1);
+		start = (size_t)AS_NUMBER(args[1]);
+	}
+
+	size_t index = findSubstring(string->chars + start, string->length - start, needle->chars, needle->length);
+	return index == STRING_NOT_FOUND ? NUMBER_VAL(-1) : NUMBER_VAL((double)(start + index));
+}
+
+Value stringCountNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	if (!expectString(vm, args[0], "first", hasError)) return pop(vm);
+
+	ObjString* string = AS_STRING(*bound);
+	ObjString* needle = AS_STRING(args[0]);
+	if (needle->length == 0) return NUMBER_VAL((double)(string->length + 1));
+
+	size_t count = 0;
+	size_t offset = 0;
+	size_t index;
+	while ((index = findSubstring(string->chars + offset, string->length - offset, needle->chars, needle->length)) != STRING_NOT_FOUND) {
+		count++;
+		offset += index + needle->length;
+	}
+
+	return NUMBER_VAL((double)count);
+}
+
+Value stringStartsWithNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	if (!expectString(vm, args[0], "first", hasError)) return pop(vm);
+
+	ObjString* string = AS_STRING(*bound);
+	ObjString* prefix = AS_STRING(args[0]);
+	return BOOL_VAL(prefix->length <= string->length && memcmp(string->chars, prefix->chars, prefix->length) == 0);
+}
+
+Value stringEndsWithNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	if (!expectString(vm, args[0], "first", hasError)) return pop(vm);
+
+	ObjString* string = AS_STRING(*bound);
+	ObjString* suffix = AS_STRING(args[0]);
+	return BOOL_VAL(suffix->length <= string->length && memcmp(string->chars + string->length - suffix->length, suffix->chars, suffix->length) == 0);
+}
+
+Value stringSplitNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	if (!expectString(vm, args[0], "first", hasError)) return pop(vm);
+
+	ObjString* string = AS_STRING(*bound);
+	ObjString* separator = AS_STRING(args[0]);
+
+	ValueArray empty;
+	initValueArray(&empty);
+	ObjList* list = newList(vm, empty);
+	push(vm, OBJ_VAL(list)); // Keeps the pieces reachable while they are allocated.
+
+	if (separator->length == 0) {
+		reserveValueArray(vm, &list->items, string->length);
+		for (size_t i = 0; i < string->length; i++) {
+			writeValueArray(vm, &list->items, OBJ_VAL(copyString(vm, &string->chars[i], 1)));
+		}
+		return pop(vm);
+	}
+
+	size_t offset = 0;
+	for (;;) {
+		size_t index = findSubstring(string->chars + offset, string->length - offset, separator->chars, separator->length);
+		size_t pieceLength = index == STRING_NOT_FOUND ? string->length - offset : index;
+
+		reserveValueArray(vm, &list->items, list->items.count + 1); // Grow first, the new piece is unrooted until stored.
+		writeValueArray(vm, &list->items, OBJ_VAL(newStringView(vm, string, offset, pieceLength)));
+
+		if (index == STRING_NOT_FOUND) break;
+		offset += index + separator->length;
+	}
+
+	return pop(vm);
+}
+
+// Called on the separator: ", ".join(list).
+Value stringJoinNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	if (!IS_LIST(args[0])) {
+		*hasError = !throwException(vm, "TypeException", "Expected first parameter to be a list.");
+		return pop(vm);
+	}
+
+	ObjString* separator = AS_STRING(*bound);
+	ValueArray* items = &AS_LIST(args[0])->items;
+
+	size_t length = 0;
+	for (size_t i = 0; i < items->count; i++) {
+		if (!IS_STRING(items->values[i])) {
+			*hasError = !throwException(vm, "TypeException", "Can only join lists of strings.");
+			return pop(vm);
+		}
+		length += AS_STRING(items->values[i])->length;
+	}
+	if (items->count > 1) length += separator->length * (items->count - 1);
+
+	char* chars = ALLOCATE(vm, char, length + 1);
+	char* dest = chars;
+	for (size_t i = 0; i < items->count; i++) {
+		if (i != 0) {
+			memcpy(dest, separator->chars, separator->length);
+			dest += separator->length;
+		}
+		ObjString* item = AS_STRING(items->values[i]);
+		memcpy(dest, item->chars, item->length);
+		dest += item->length;
+	}
+	chars[length] = '\0';
+
+	return OBJ_VAL(takeString(vm, chars, length));
+}
+
+Value stringReplaceNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	if (!expectString(vm, args[0], "first", hasError)) return pop(vm);
+	if (!expectString(vm, args[1], "second", hasError)) return pop(vm);
+
+	ObjString* string = AS_STRING(*bound);
+	ObjString* from = AS_STRING(args[0]);
+	ObjString* to = AS_STRING(args[1]);
+
+	if (from->length == 0) return *bound;
+
+	// Count first so the result is allocated exactly once.
+	size_t count = 0;
+	size_t offset = 0;
+	size_t index;
+	while ((index = findSubstring(string->chars + offset, string->length - offset, from->chars, from->length)) != STRING_NOT_FOUND) {
+		count++;
+		offset += index + from->length;
+	}
+	if (count == 0) return *bound;
+
+	size_t length = string->length - count * from->length + count * to->length;
+	char* chars = ALLOCATE(vm, char, length + 1);
+	char* dest = chars;
+
+	offset = 0;
+	while ((index = findSubstring(string->chars + offset, string->length - offset, from->chars, from->length)) != STRING_NOT_FOUND) {
+		memcpy(dest, string->chars + offset, index);
+		dest += index;
+		memcpy(dest, to->chars, to->length);
+		dest += to->length;
+		offset += index + from->length;
+	}
+	memcpy(dest, string->chars + offset, string->length - offset);
+	chars[length] = '\0';
+
+	return OBJ_VAL(takeString(vm, chars, length));
+}
+
+Value stringTrimNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	ObjString* string = AS_STRING(*bound);
+
+	size_t start = 0;
+	size_t end = string->length;
+	while (start < end && isWhitespace(string->chars[start])) start++;
+	while (end > start && isWhitespace(string->chars[end - 1])) end--;
+
+	return OBJ_VAL(newStringView(vm, string, start, end - start));
+}
+
+// Clamps a possibly negative slice bound into [0, length].
+static size_t clampIndex(double index, size_t length) {
+	if (index < 0) index += (double)length;
+	if (index < 0) return 0;
+	if (index > (double)length) return length;
+	return (size_t)index;
+}
+
+Value stringSliceNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	if (argCount > 2) {
+		*hasError = !throwException(vm, "ArityException", "Expected 1 or 2 arguments but got %d.", (int)argCount);
+		return pop(vm);
+	}
+
+	for (size_t i = 0; i < argCount; i++) {
+		if (!IS_NUMBER(args[i]) || ceil(AS_NUMBER(args[i])) != AS_NUMBER(args[i])) {
+			*hasError = !throwException(vm, "TypeException", "Expected slice bounds to be integers.");
+			return pop(vm);
+		}
+	}
+
+	ObjString* string = AS_STRING(*bound);
+	size_t start = clampIndex(AS_NUMBER(args[0]), string->length);
+	size_t end = argCount == 2 ? clampIndex(AS_NUMBER(args[1]), string->length) : string->length;
+	if (end < start) end = start;
+
+	return OBJ_VAL(newStringView(vm, string, start, end - start));
+}
+
+static Value changeCase(VM* vm, ObjString* string, char from) {
+	char* chars = ALLOCATE(vm, char, string->length + 1);
+	convertCase(chars, string->chars, string->length, from);
+	chars[string->length] = '\0';
+
+	return OBJ_VAL(takeString(vm, chars, string->length));
+}
+
+Value stringUpperNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	return changeCase(vm, AS_STRING(*bound), 'a');
+}
+
+Value stringLowerNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	return changeCase(vm, AS_STRING(*bound), 'A');
+}
+
+Value stringRepeatNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
+	if (!IS_NUMBER(args[0]) || !isfinite(AS_NUMBER(args[0])) || AS_NUMBER(args[0]) < 0 || ceil(AS_NUMBER(args[0])) != AS_NUMBER(args[0])) {
+		*hasError = !throwException(vm, "TypeException", "Expected first parameter to be a non-negative integer.");
+		return pop(vm);
+	}
+
+	// Counts too large for size_t saturate, and the result's length is checked before it is multiplied out.
+	ObjString* string = AS_STRING(*bound);
+	double count = AS_NUMBER(args[0]);
+	size_t times = count < (double)SIZE_MAX ? (size_t)count : SIZE_MAX;
+	if (times != 0 && string->length > (SIZE_MAX - 1) / times) {
+		*hasError = !throwException(vm, "RangeException", "Repeated string is too long.");
+		return pop(vm);
+	}
+
+	size_t length = string->length * times;
+
+	char* chars = ALLOCATE(vm, char, length + 1);
+	if (length != 0) {
+		// Double the copied prefix each step rather than copying one repetition at a time.
+		memcpy(chars, string->chars, string->length);
+		size_t copied = string->length;
+		while (copied < length) {
+			size_t chunk = copied <= length - copied ? copied : length - copied;
+			memcpy(chars + copied, chars, chunk);
+			copied += chunk;
+		}
+	}
+	chars[length] = '\0';
+
+	return OBJ_VAL(takeString(vm, chars, length));
+}
+
 Value stringIteratorNative(VM* vm, size_t argCount, Value* args, Value* bound, bool* hasError) {
 	ObjInstance* inst = newInstance(vm, vm->iteratorClass);
+	push(vm, OBJ_VAL(inst));
 
 	tableSet(vm, &inst->fields, copyString(vm, "index", 5), NUMBER_VAL(0));
 
 	tableSet(vm, &inst->fields, copyString(vm, "data", 4), *bound);
 
+	pop(vm);
 	return OBJ_VAL(inst);
 }
 
 void defineStringMethods(VM* vm) {
 	defineNative(vm, &vm->stringMethods, "length", stringLengthNative, 0, false);
+	defineNative(vm, &vm->stringMethods, "indexOf", stringIndexOfNative, 1, true);
+	defineNative(vm, &vm->stringMethods, "find", stringIndexOfNative, 1, true);
+	defineNative(vm, &vm->stringMethods, "count", stringCountNative, 1, false);
+	defineNative(vm, &vm->stringMethods, "startsWith", stringStartsWithNative, 1, false);
+	defineNative(vm, &vm->stringMethods, "endsWith", stringEndsWithNative, 1, false);
+	defineNative(vm, &vm->stringMethods, "split", stringSplitNative, 1, false);
+	defineNative(vm, &vm->stringMethods, "join", stringJoinNative, 1, false);
+	defineNative(vm, &vm->stringMethods, "replace", stringReplaceNative, 2, false);
+	defineNative(vm, &vm->stringMethods, "trim", stringTrimNative, 0, false);
+	defineNative(vm, &vm->stringMethods, "slice", stringSliceNative, 1, true);
+	defineNative(vm, &vm->stringMethods, "upper", stringUpperNative, 0, false);
+	defineNative(vm, &vm->stringMethods, "lower", stringLowerNative, 0, false);
+	defineNative(vm, &vm->stringMethods, "repeat", stringRepeatNative, 1, false);
 	defineNative(vm, &vm->stringMethods, "iterator", stringIteratorNative, 0, false);
 }
\ No newline at end of file
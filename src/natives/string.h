@@ -1,3 +1,8 @@
 #pragma once
 #include "globals.h"
+
+#define STRING_NOT_FOUND ((size_t)-1)
+
+size_t findSubstring(const char* haystack, size_t length, const char* needle, size_t needleLength);
+
 void defineStringMethods(VM* vm);
\ No newline at end of file
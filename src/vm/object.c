@@ -13,11 +13,25 @@
     (type*)allocateObject(vm, sizeof(type), objectType)
 
 Obj* allocateObject(VM* vm, size_t size, ObjType type) {
-	Obj* object = (Obj*)reallocate(vm, NULL, 0, size);
+	Obj* object = (Obj*)allocateCell(vm, size);
 	object->type = type;
-	object->isMarked = false;
-	object->next = vm->objects;
-	vm->objects = object;
+	object->isRemembered = false;
+
+	// Minor collections wait while a full collection is marking, so objects allocated meanwhile are left
+	// to it instead. This keeps the young generation it has to sweep in its final pause small.
+	if (vm->gcPhase == GC_MARKING) {
+		object->isOld = true;
+	}
+	else {
+		object->isOld = false;
+
+		if (vm->youngCapacity < vm->youngCount + 1) {
+			vm->youngCapacity = vm->youngCapacity < 8 ? 8 : vm->youngCapacity * 2;
+			vm->youngObjects = realloc(vm->youngObjects, sizeof(Obj*) * vm->youngCapacity);
+			if (vm->youngObjects == NULL) exit(1);
+		}
+		vm->youngObjects[vm->youngCount++] = object;
+	}
 
 #ifdef FOX_DEBUG_LOG_GC
 	printf("%p allocate %ld for %d\n", (void*)object, size, type);
@@ -26,19 +40,37 @@ Obj* allocateObject(VM* vm, size_t size, ObjType type) {
 	return object;
 }
 
-static ObjString* allocateString(VM* root, VM* vm, char* chars, size_t length, uint32_t hash) {
-	ObjString* string = ALLOCATE_OBJ(vm, ObjString, OBJ_STRING);
-	string->length = length;
-	string->chars = chars;
+static ObjString* internNewString(VM* vm, ObjString* string, uint32_t hash) {
 	string->hash = hash;
+	string->interned = true;
+	string->parent = NULL;
+	string->retained = 0;
 
 	push(vm, OBJ_VAL(string));
-	tableSet(root, &root->strings, string, NULL_VAL);
+	tableSet(vm, &vm->strings, string, NULL_VAL);
 	pop(vm);
 
 	return string;
 }
 
+// Takes ownership of chars.
+static ObjString* allocateString(VM* vm, char* chars, size_t length, uint32_t hash) {
+	ObjString* string = ALLOCATE_OBJ(vm, ObjString, OBJ_STRING);
+	string->length = length;
+	string->chars = chars;
+	return internNewString(vm, string, hash);
+}
+
+// Copies chars into the string itself, length must be at most STRING_INLINE_MAX.
+static ObjString* allocateInlineString(VM* vm, const char* chars, size_t length, uint32_t hash) {
+	ObjString* string = (ObjString*)allocateObject(vm, sizeof(ObjString) + length + 1, OBJ_STRING);
+	string->length = length;
+	string->chars = string->inlineChars;
+	memcpy(string->inlineChars, chars, length);
+	string->inlineChars[length] = '\0';
+	return internNewString(vm, string, hash);
+}
+
 //FNV-1a
 static uint32_t hashString(const char* key, size_t length) {
 	uint32_t hash = 2166136261u;
@@ -51,39 +83,79 @@ static uint32_t hashString(const char* key, size_t length) {
 	return hash;
 }
 
+// A full collection sweeping in slices deletes dead strings from the intern table only as it frees them.
+// Finding one first revives it, as its mark stops the sweep from freeing it.
+static ObjString* findInterned(VM* vm, const char* chars, size_t length, uint32_t hash) {
+	ObjString* interned = tableFindString(&vm->strings, chars, length, hash);
+	if (interned != NULL && vm->gcPhase == GC_SWEEPING) {
+		heapSetMark(interned);
+	}
+	return interned;
+}
+
 ObjString* takeString(VM* vm, char* chars, size_t length) {
 	uint32_t hash = hashString(chars, length);
 
-	VM* root = vm;
-
-	while (root->parent != NULL) root = root->parent;
-
-	ObjString* interned = tableFindString(&root->strings, chars, length,
-		hash);
+	ObjString* interned = findInterned(vm, chars, length, hash);
 	if (interned != NULL) {
 		FREE_ARRAY(vm, char, chars, length + 1);
 		return interned;
 	}
 
-	return allocateString(root, vm, chars, length, hash);
+	if (length <= STRING_INLINE_MAX) {
+		ObjString* string = allocateInlineString(vm, chars, length, hash);
+		FREE_ARRAY(vm, char, chars, length + 1);
+		return string;
+	}
+
+	return allocateString(vm, chars, length, hash);
 }
 
 ObjString* copyString(VM* vm, const char* chars, size_t length) {
 
 	uint32_t hash = hashString(chars, length);
 
-	VM* root = vm;
-
-	while (root->parent != NULL) root = root->parent;
-
-	ObjString* interned = tableFindString(&root->strings, chars, length, hash);
+	ObjString* interned = findInterned(vm, chars, length, hash);
 	if (interned != NULL) return interned;
 
+	if (length <= STRING_INLINE_MAX) return allocateInlineString(vm, chars, length, hash);
+
 	char* heapChars = ALLOCATE(vm, char, length + 1);
 	memcpy(heapChars, chars, length);
 	heapChars[length] = '\0';
 
-	return allocateString(root, vm, heapChars, length, hash);
+	return allocateString(vm, heapChars, length, hash);
+}
+
+// Creates a string sharing the chars of string. The view keeps its parent alive, and is not interned.
+ObjString* newStringView(VM* vm, ObjString* string, size_t start, size_t length) {
+	if (start == 0 && length == string->length) return string;
+	if (length < STRING_VIEW_MIN_LENGTH) return copyString(vm, string->chars + start, length);
+
+	// Always point at the string which owns the chars, so views never chain.
+	if (string->parent != NULL) {
+		start += (size_t)(string->chars - string->parent->chars);
+		string = string->parent;
+	}
+
+	push(vm, OBJ_VAL(string));
+	ObjString* view = ALLOCATE_OBJ(vm, ObjString, OBJ_STRING);
+	pop(vm);
+
+	view->length = length;
+	view->chars = string->chars + start;
+	view->hash = hashString(view->chars, length);
+	view->interned = false;
+	view->parent = string;
+	view->retained = 0;
+
+	return view;
+}
+
+// Returns the interned string with the same contents, for use as a table key.
+ObjString* internString(VM* vm, ObjString* string) {
+	if (string->interned) return string;
+	return copyString(vm, string->chars, string->length);
 }
 
 ObjFunction* newFunction(VM* vm) {
@@ -92,7 +164,9 @@ ObjFunction* newFunction(VM* vm) {
 	function->arity = 0;
 	function->name = NULL;
 	function->upvalueCount = 0;
+	function->module = vm->module;
 	initChunk(&function->chunk);
+	function->chunk.constants.owner = &function->obj;
 	return function;
 }
 
@@ -101,18 +175,30 @@ ObjNative* newNative(VM* vm, NativeFn function, size_t arity, bool varArgs) {
 	native->function = function;
 	native->arity = arity;
 	native->varArgs = varArgs;
+	native->bound = NULL_VAL;
+	native->isBound = false;
 	return native;
 }
 
 ObjClosure* newClosure(VM* vm, ObjFunction* function) {
-	ObjUpvalue** upvalues = ALLOCATE(vm, ObjUpvalue*, function->upvalueCount);
-	for (size_t i = 0; i < function->upvalueCount; i++) {
-		upvalues[i] = NULL;
+	size_t count = function->upvalueCount;
+	ObjClosure* closure;
+
+	if (count <= CLOSURE_INLINE_MAX) {
+		closure = (ObjClosure*)allocateObject(vm, sizeof(ObjClosure) + sizeof(ObjUpvalue*) * count, OBJ_CLOSURE);
+		closure->upvalues = closure->inlineUpvalues;
+	}
+	else {
+		ObjUpvalue** upvalues = ALLOCATE(vm, ObjUpvalue*, count);
+		closure = ALLOCATE_OBJ(vm, ObjClosure, OBJ_CLOSURE);
+		closure->upvalues = upvalues;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		closure->upvalues[i] = NULL;
 	}
-	ObjClosure* closure = ALLOCATE_OBJ(vm, ObjClosure, OBJ_CLOSURE);
 	closure->function = function;
-	closure->upvalues = upvalues;
-	closure->upvalueCount = function->upvalueCount;
+	closure->upvalueCount = count;
 	return closure;
 }
 
@@ -126,9 +212,12 @@ ObjUpvalue* newUpvalue(VM* vm, Value* slot) {
 
 
 ObjClass* newClass(VM* vm, ObjString* name) {
+	push(vm, OBJ_VAL(name)); // The name may not be rooted anywhere else yet.
 	ObjClass* class = ALLOCATE_OBJ(vm, ObjClass, OBJ_CLASS);
+	pop(vm);
 	class->name = name;
 	initTable(&class->methods);
+	class->methods.owner = &class->obj;
 	return class;
 }
 
@@ -136,6 +225,7 @@ ObjInstance* newInstance(VM* vm, ObjClass* class) {
 	ObjInstance* instance = ALLOCATE_OBJ(vm, ObjInstance, OBJ_INSTANCE);
 	instance->class = class;
 	initTable(&instance->fields);
+	instance->fields.owner = &instance->obj;
 	return instance;
 }
 
@@ -146,94 +236,157 @@ ObjBoundMethod* newBoundMethod(VM* vm, Value receiver, ObjClosure* method) {
 	return bound;
 }
 
+// Takes ownership of items. Few enough are moved into the list's own storage.
 ObjList* newList(VM* vm, ValueArray items) {
 	ObjList* list = ALLOCATE_OBJ(vm, ObjList, OBJ_LIST);
 	list->items = items;
+	list->items.owner = &list->obj;
+
+	if (items.count <= LIST_INLINE_CAPACITY) {
+		if (items.count > 0) memcpy(list->inlineItems, items.values, sizeof(Value) * items.count);
+		FREE_ARRAY(vm, Value, items.values, items.capacity);
+		list->items.values = list->inlineItems;
+		list->items.capacity = LIST_INLINE_CAPACITY;
+	}
 	return list;
 }
 
-char* functionToString(ObjFunction* value) {
-	if (value->name == NULL) {
-		size_t sizeNeeded = 8 + 1;
-		char* buffer = malloc(sizeNeeded);
-		sprintf(buffer, "<script>");
-		return buffer;
+ObjMap* newMap(VM* vm) {
+	ObjMap* map = ALLOCATE_OBJ(vm, ObjMap, OBJ_MAP);
+	initValueTable(&map->items);
+	map->items.owner = &map->obj;
+	return map;
+}
+
+size_t arrayElementSize(ArrayType type) {
+	switch (type) {
+		case ARRAY_FLOAT64: return sizeof(double);
+		case ARRAY_INT32: return sizeof(int32_t);
+		case ARRAY_UINT8: return sizeof(uint8_t);
+	}
+	return 0; // Unreachable
+}
+
+const char* arrayTypeName(ArrayType type) {
+	switch (type) {
+		case ARRAY_FLOAT64: return "Float64Array";
+		case ARRAY_INT32: return "Int32Array";
+		case ARRAY_UINT8: return "Uint8Array";
+	}
+	return NULL; // Unreachable
+}
+
+ObjArray* newArray(VM* vm, ArrayType type, size_t count) {
+	size_t size = arrayElementSize(type) * count;
+	uint8_t* data = ALLOCATE(vm, uint8_t, size);
+	if (data != NULL) memset(data, 0, size);
+
+	ObjArray* array = ALLOCATE_OBJ(vm, ObjArray, OBJ_ARRAY);
+	array->arrayType = type;
+	array->count = count;
+	array->data = data;
+	return array;
+}
+
+static void writeFunction(Buffer* buffer, ObjFunction* function) {
+	if (function->name == NULL) {
+		bufferWriteString(buffer, "<script>");
+		return;
 	}
 
-	size_t sizeNeeded = snprintf(NULL, 0, "<function %s>", value->name->chars) + 1;
-	char* buffer = malloc(sizeNeeded);
-	sprintf(buffer, "<function %s>", value->name->chars);
-	return buffer;
+	bufferWriteString(buffer, "<function ");
+	bufferWrite(buffer, function->name->chars, function->name->length);
+	bufferWriteChar(buffer, '>');
 }
 
 //TODO REPR functions
-char* objectToString(VM* vm, Value value) {
+void writeObject(VM* vm, Buffer* buffer, Value value) {
 	switch (OBJ_TYPE(value)) {
 
 		case OBJ_LIST: {
 			ObjList* list = AS_LIST(value);
 
-			size_t itemLengths = 1;
-
+			bufferWriteChar(buffer, '[');
 			for (size_t i = 0; i < list->items.count; i++) {
-				itemLengths += snprintf(NULL, 0, i == list->items.count - 1 ? "%s" : "%s, ", valueToString(vm, list->items.values[i]));
+				if (i != 0) bufferWrite(buffer, ", ", 2);
+				writeValue(vm, buffer, list->items.values[i]);
 			}
+			bufferWriteChar(buffer, ']');
+			break;
+		}
 
-			itemLengths += 1;
-
-			char* buffer = malloc(itemLengths + 1);
+		case OBJ_MAP: {
+			ValueTable* items = &AS_MAP(value)->items;
 
-			buffer[0] = '[';
+			bufferWriteChar(buffer, '{');
+			bool first = true;
+			for (int i = 0; i <= items->capacity; i++) {
+				if (!CTRL_IS_FULL(items->control[i])) continue;
 
-			size_t index = 1;
-			for (size_t i = 0; i < list->items.count; i++) {
-				index += sprintf(&buffer[index], i == list->items.count - 1 ? "%s" : "%s, ", valueToString(vm, list->items.values[i]));
+				if (!first) bufferWrite(buffer, ", ", 2);
+				writeValue(vm, buffer, items->entries[i].key);
+				bufferWrite(buffer, ": ", 2);
+				writeValue(vm, buffer, items->entries[i].value);
+				first = false;
 			}
+			bufferWriteChar(buffer, '}');
+			break;
+		}
+
+		case OBJ_ARRAY: {
+			ObjArray* array = AS_ARRAY(value);
 
-			buffer[itemLengths - 1] = ']';
-			buffer[itemLengths] = '\0';
-			return buffer;
+			bufferWriteString(buffer, arrayTypeName(array->arrayType));
+			bufferWriteChar(buffer, '[');
+			for (size_t i = 0; i < array->count; i++) {
+				if (i != 0) bufferWrite(buffer, ", ", 2);
+				writeValue(vm, buffer, NUMBER_VAL(arrayGet(array, i)));
+			}
+			bufferWriteChar(buffer, ']');
+			break;
 		}
 
 		case OBJ_CLASS: {
-			size_t sizeNeeded = snprintf(NULL, 0, "<class %s>", AS_CLASS(value)->name->chars) + 1;
-			char* buffer = malloc(sizeNeeded);
-			sprintf(buffer, "<class %s>", AS_CLASS(value)->name->chars);
-			return buffer;
+			ObjString* name = AS_CLASS(value)->name;
+			bufferWriteString(buffer, "<class ");
+			bufferWrite(buffer, name->chars, name->length);
+			bufferWriteChar(buffer, '>');
+			break;
 		}
 
 		case OBJ_INSTANCE: {
-			ObjInstance* inst = AS_INSTANCE(value);
-
-			size_t sizeNeeded = snprintf(NULL, 0, "<instance %s>", inst->class->name->chars) + 1;
-			char* buffer = malloc(sizeNeeded);
-			sprintf(buffer, "<instance %s>", inst->class->name->chars);
-			return buffer;
+			ObjString* name = AS_INSTANCE(value)->class->name;
+			bufferWriteString(buffer, "<instance ");
+			bufferWrite(buffer, name->chars, name->length);
+			bufferWriteChar(buffer, '>');
+			break;
 		}
 
-		case OBJ_STRING: {
-			size_t sizeNeeded = snprintf(NULL, 0, "%s", AS_CSTRING(value)) + 1;
-			char* buffer = malloc(sizeNeeded);
-			sprintf(buffer, "%s", AS_CSTRING(value));
-			return buffer;
-		}
+		case OBJ_STRING:
+			bufferWrite(buffer, AS_STRING(value)->chars, AS_STRING(value)->length);
+			break;
 
-		case OBJ_FUNCTION: {
-			return functionToString(AS_FUNCTION(value));
-		}
+		case OBJ_FUNCTION:
+			writeFunction(buffer, AS_FUNCTION(value));
+			break;
 
 		case OBJ_CLOSURE:
-			return functionToString(AS_CLOSURE(value)->function);
+			writeFunction(buffer, AS_CLOSURE(value)->function);
+			break;
 
 		case OBJ_BOUND_METHOD:
-			return functionToString(AS_BOUND_METHOD(value)->method->function);
+			writeFunction(buffer, AS_BOUND_METHOD(value)->method->function);
+			break;
 
-		case OBJ_NATIVE: {
-			size_t sizeNeeded = 17 + 1;
-			char* buffer = malloc(sizeNeeded);
-			strcpy(buffer, "<native function>");
-			return buffer;
-		}
+		case OBJ_NATIVE:
+			bufferWriteString(buffer, "<native function>");
+			break;
 	}
-	return NULL; // Unreachable
+}
+
+char* objectToString(VM* vm, Value value) {
+	Buffer buffer;
+	initBuffer(&buffer);
+	writeObject(vm, &buffer, value);
+	return bufferTake(&buffer);
 }
\ No newline at end of file
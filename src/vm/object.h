@@ -3,8 +3,11 @@
 #include <vm/value.h>
 #include <vm/chunk.h>
 #include <vm/table.h>
+#include <core/buffer.h>
+#include <core/heap.h>
 
 typedef struct VM VM;
+typedef struct Module Module;
 
 typedef enum {
 	OBJ_CLOSURE,
@@ -15,13 +18,19 @@ typedef enum {
 	OBJ_CLASS,
 	OBJ_INSTANCE,
 	OBJ_BOUND_METHOD,
-	OBJ_LIST
+	OBJ_LIST,
+	OBJ_MAP,
+	OBJ_ARRAY
 } ObjType;
 
+#define OBJ_TYPE_COUNT (OBJ_ARRAY + 1)
+
+// The header of every object, kept to a few bytes as the heap finds objects through its pages and keeps
+// their mark bits itself. Objects put their own small fields in the padding which follows it.
 struct Obj {
-	ObjType type;
-	bool isMarked;
-	struct Obj* next; // Used to free objects after execution. Single Linked list
+	uint8_t type; // An ObjType.
+	bool isOld; // Survived a collection, so only full collections can free it.
+	bool isRemembered; // Old object in the remembered set, as it may reference young objects.
 };
 
 static inline bool isObjType(Value value, ObjType type) {
@@ -56,14 +65,21 @@ static inline bool isObjType(Value value, ObjType type) {
 #define IS_LIST(value) isObjType(value, OBJ_LIST)
 #define AS_LIST(value) ((ObjList*)AS_OBJ(value))
 
+#define IS_MAP(value) isObjType(value, OBJ_MAP)
+#define AS_MAP(value) ((ObjMap*)AS_OBJ(value))
+
+#define IS_ARRAY(value) isObjType(value, OBJ_ARRAY)
+#define AS_ARRAY(value) ((ObjArray*)AS_OBJ(value))
+
 typedef struct {
 	Obj obj;
-	size_t arity;
-	size_t upvalueCount;
 	bool lambda;
 	bool varArgs;
+	size_t arity;
+	size_t upvalueCount;
 	Chunk chunk;
 	ObjString* name;
+	Module* module; // The file the function was compiled in, whose globals it reads and writes.
 } ObjFunction;
 
 ObjFunction* newFunction(struct VM* vm);
@@ -72,11 +88,11 @@ typedef Value(*NativeFn)(VM* vm, size_t argCount, Value* args, Value* bound, boo
 
 typedef struct {
 	Obj obj;
-	size_t arity;
 	bool varArgs;
+	bool isBound;
+	size_t arity;
 	NativeFn function;
 	Value bound;
-	bool isBound;
 } ObjNative;
 
 ObjNative* newNative(VM* vm, NativeFn function, size_t arity, bool varArgs);
@@ -93,23 +109,48 @@ ObjUpvalue* newUpvalue(VM* vm, Value* slot);
 typedef struct {
 	Obj obj;
 	ObjFunction* function;
-	ObjUpvalue** upvalues;
+	ObjUpvalue** upvalues; // Points at inlineUpvalues unless there are too many to fit in a heap cell.
 	size_t upvalueCount;
+	ObjUpvalue* inlineUpvalues[];
 } ObjClosure;
 
+#define CLOSURE_INLINE_MAX ((HEAP_MAX_CELL - sizeof(ObjClosure)) / sizeof(ObjUpvalue*))
+
 ObjClosure* newClosure(VM* vm, ObjFunction* function);
 
+// Strings shorter than this are copied and interned rather than viewed.
+#define STRING_VIEW_MIN_LENGTH 16
+
 struct ObjString {
 	Obj obj;
-	size_t length;
-	char* chars;
+	bool interned; // Interned strings are unique, so they compare by pointer.
 	uint32_t hash;
+	size_t length;
+	char* chars; // NUL terminated unless the string is a view.
+	ObjString* parent; // Views borrow chars from their parent. NULL when the string owns its chars.
+	size_t retained; // Bytes of this string used by live views, only meaningful during a collection.
+	char inlineChars[]; // Holds the chars of strings short enough to fit in a heap cell with them.
 };
 
+// The longest string kept inline, leaving room for its NUL.
+#define STRING_INLINE_MAX (HEAP_MAX_CELL - sizeof(ObjString) - 1)
+
+static inline bool isInlineString(ObjString* string) {
+	return string->chars == string->inlineChars;
+}
+
 ObjString* copyString(struct VM* vm, const char* chars, size_t length);
 
+ObjString* newStringView(VM* vm, ObjString* string, size_t start, size_t length);
+
+ObjString* internString(VM* vm, ObjString* string);
+
+#define IS_STRING_VIEW(value) (IS_STRING(value) && !AS_STRING(value)->interned)
+
 char* objectToString(VM* vm, Value value);
 
+void writeObject(VM* vm, Buffer* buffer, Value value);
+
 ObjString* takeString(struct VM* vm, char* chars, size_t length);
 
 typedef struct {
@@ -136,9 +177,74 @@ typedef struct {
 
 ObjBoundMethod* newBoundMethod(VM* vm, Value receiver, ObjClosure* method);
 
+// Lists start out with room for a few items in the object itself, directly after the array using them,
+// and only allocate once they outgrow it.
+#define LIST_INLINE_CAPACITY 4
+
 typedef struct {
 	Obj obj;
 	ValueArray items;
+	Value inlineItems[LIST_INLINE_CAPACITY];
 } ObjList;
 
-ObjList* newList(VM* vm, ValueArray items);
\ No newline at end of file
+ObjList* newList(VM* vm, ValueArray items);
+
+typedef struct {
+	Obj obj;
+	ValueTable items;
+} ObjMap;
+
+ObjMap* newMap(VM* vm);
+
+typedef enum {
+	ARRAY_FLOAT64,
+	ARRAY_INT32,
+	ARRAY_UINT8
+} ArrayType;
+
+// A fixed length array of unboxed numbers.
+typedef struct {
+	Obj obj;
+	ArrayType arrayType;
+	size_t count;
+	union {
+		void* data;
+		double* f64;
+		int32_t* i32;
+		uint8_t* u8;
+	};
+} ObjArray;
+
+ObjArray* newArray(VM* vm, ArrayType type, size_t count);
+
+size_t arrayElementSize(ArrayType type);
+
+const char* arrayTypeName(ArrayType type);
+
+static inline double arrayGet(ObjArray* array, size_t index) {
+	switch (array->arrayType) {
+		case ARRAY_FLOAT64: return array->f64[index];
+		case ARRAY_INT32: return (double)array->i32[index];
+		case ARRAY_UINT8: return (double)array->u8[index];
+	}
+	return 0; // Unreachable
+}
+
+// Clamps value into [min, max], with NaN as 0, so that converting the result to an integer is defined.
+static inline double clampArrayValue(double value, double min, double max) {
+	if (value != value) return 0;
+	if (value < min) return min;
+	if (value > max) return max;
+	return value;
+}
+
+// Integer arrays truncate towards zero and saturate at the limits of their type, like a Uint8ClampedArray
+// but without rounding, and NaN stores 0. An Int32Array given 3000000000 or Infinity stores 2147483647, and
+// a Uint8Array given 256 stores 255 and given -1 stores 0.
+static inline void arraySet(ObjArray* array, size_t index, double value) {
+	switch (array->arrayType) {
+		case ARRAY_FLOAT64: array->f64[index] = value; break;
+		case ARRAY_INT32: array->i32[index] = (int32_t)clampArrayValue(value, INT32_MIN, INT32_MAX); break;
+		case ARRAY_UINT8: array->u8[index] = (uint8_t)clampArrayValue(value, 0, UINT8_MAX); break;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,777 @@
+#include "snapshot.h"
+#include <core/common.h>
+#include <core/buffer.h>
+#include <core/file.h>
+#include <core/memory.h>
+#include <compiler/bytecode.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// An image is a header followed by every object reachable from the saved globals, numbered in the order
+// they were found. First comes the shape of each object, enough to allocate it, then what each one
+// holds, then the contents of maps, which are filled in last as lists they use as keys hash by their
+// items. Last are the globals themselves. Numbers are in the machine's own byte order.
+typedef struct {
+	char magic[4];
+	uint32_t version;
+	uint32_t bytecodeVersion; // Functions are saved as their compiled code.
+	uint32_t builtinCount;
+	uint64_t builtinsHash; // Of the builtins the image may refer to, which must match those of the VM loading it.
+	uint64_t bodyHash;
+} SnapshotHeader;
+
+#define SNAPSHOT_MAGIC "FOXS"
+
+typedef enum {
+	SNAPSHOT_NULL,
+	SNAPSHOT_FALSE,
+	SNAPSHOT_TRUE,
+	SNAPSHOT_NUMBER,
+	SNAPSHOT_OBJECT,
+	SNAPSHOT_BUILTIN
+} SnapshotTag;
+
+// Objects to their numbers, by address.
+typedef struct {
+	Obj* object;
+	uint32_t id;
+} ObjectId;
+
+typedef struct {
+	size_t count;
+	size_t capacity; // A power of two.
+	ObjectId* entries;
+} ObjectIds;
+
+// Every object reachable from the builtins other than strings, which images copy like any other. As the
+// builtins are created the same way by each VM, they are always found in the same order.
+typedef struct {
+	size_t count;
+	size_t capacity;
+	Obj** objects;
+	ObjectIds ids;
+	Buffer names; // What each was found under, hashed to tell whether an image was made with the same builtins.
+} Builtins;
+
+typedef struct {
+	VM* vm;
+	Builtins builtins;
+	ObjectIds ids;
+	size_t count;
+	size_t capacity;
+	Obj** objects;
+	Buffer shapes;
+	Buffer contents;
+	Buffer mapContents;
+	const char* error;
+} SnapshotWriter;
+
+typedef struct {
+	VM* vm;
+	Builtins* builtins;
+	Reader reader;
+	ObjList* objects; // Keeps the objects read so far rooted.
+} SnapshotReader;
+
+static const char* snapshotPath = NULL;
+static bool isSnapshotSet = false;
+
+bool setStartupSnapshot(const char* path) {
+	if (*path == '\0') return false;
+	snapshotPath = path;
+	isSnapshotSet = true;
+	return true;
+}
+
+const char* startupSnapshot() {
+	if (!isSnapshotSet) {
+		isSnapshotSet = true;
+		char* path = getenv("FOX_SNAPSHOT");
+		if (path != NULL && *path != '\0') snapshotPath = path;
+	}
+	return snapshotPath;
+}
+
+static void initObjectIds(ObjectIds* ids) {
+	ids->count = 0;
+	ids->capacity = 0;
+	ids->entries = NULL;
+}
+
+static void freeObjectIds(ObjectIds* ids) {
+	free(ids->entries);
+	initObjectIds(ids);
+}
+
+static ObjectId* findObjectId(ObjectId* entries, size_t capacity, Obj* object) {
+	size_t index = (size_t)(((uintptr_t)object >> 3) * 0x9E3779B97F4A7C15u) & (capacity - 1);
+	for (;;) {
+		ObjectId* entry = &entries[index];
+		if (entry->object == NULL || entry->object == object) return entry;
+		index = (index + 1) & (capacity - 1);
+	}
+}
+
+static bool getObjectId(ObjectIds* ids, Obj* object, uint32_t* id) {
+	if (ids->count == 0) return false;
+	ObjectId* entry = findObjectId(ids->entries, ids->capacity, object);
+	if (entry->object == NULL) return false;
+	*id = entry->id;
+	return true;
+}
+
+static void setObjectId(ObjectIds* ids, Obj* object, uint32_t id) {
+	if (ids->count + 1 > ids->capacity / 2) {
+		size_t capacity = ids->capacity < 64 ? 64 : ids->capacity * 2;
+		ObjectId* entries = calloc(capacity, sizeof(ObjectId));
+		if (entries == NULL) exit(1);
+
+		for (size_t i = 0; i < ids->capacity; i++) {
+			if (ids->entries[i].object != NULL) *findObjectId(entries, capacity, ids->entries[i].object) = ids->entries[i];
+		}
+		free(ids->entries);
+		ids->entries = entries;
+		ids->capacity = capacity;
+	}
+
+	ObjectId* entry = findObjectId(ids->entries, ids->capacity, object);
+	if (entry->object == NULL) ids->count++;
+	entry->object = object;
+	entry->id = id;
+}
+
+// Appends to a malloced array of objects.
+static void appendObject(Obj*** objects, size_t* count, size_t* capacity, Obj* object) {
+	if (*count + 1 > *capacity) {
+		*capacity = *capacity < 64 ? 64 : *capacity * 2;
+		*objects = realloc(*objects, sizeof(Obj*) * *capacity);
+		if (*objects == NULL) exit(1);
+	}
+	(*objects)[(*count)++] = object;
+}
+
+static void addBuiltinTable(Builtins* builtins, Table* table);
+
+static void addBuiltin(Builtins* builtins, ObjString* name, Value value) {
+	if (!IS_OBJ(value) || IS_STRING(value)) return;
+
+	Obj* object = AS_OBJ(value);
+	uint32_t id;
+	if (getObjectId(&builtins->ids, object, &id)) return;
+
+	setObjectId(&builtins->ids, object, (uint32_t)builtins->count);
+	appendObject(&builtins->objects, &builtins->count, &builtins->capacity, object);
+
+	bufferWriteU8(&builtins->names, object->type);
+	if (name != NULL) bufferWrite(&builtins->names, name->chars, name->length);
+	bufferWriteU8(&builtins->names, 0);
+
+	if (object->type == OBJ_CLASS) {
+		addBuiltinTable(builtins, &((ObjClass*)object)->methods);
+	}
+	else if (object->type == OBJ_INSTANCE) {
+		ObjInstance* instance = (ObjInstance*)object;
+		addBuiltin(builtins, instance->class->name, OBJ_VAL(instance->class));
+		addBuiltinTable(builtins, &instance->fields);
+	}
+}
+
+static void addBuiltinTable(Builtins* builtins, Table* table) {
+	for (int i = 0; i <= table->capacity; i++) {
+		Entry* entry = &table->entries[i];
+		if (entry->key != NULL) addBuiltin(builtins, entry->key, entry->value);
+	}
+}
+
+static void findBuiltins(VM* vm, Builtins* builtins) {
+	builtins->count = 0;
+	builtins->capacity = 0;
+	builtins->objects = NULL;
+	initObjectIds(&builtins->ids);
+	initBuffer(&builtins->names);
+
+	addBuiltinTable(builtins, &vm->builtins);
+	addBuiltinTable(builtins, &vm->stringMethods);
+	addBuiltinTable(builtins, &vm->listMethods);
+	addBuiltinTable(builtins, &vm->mapMethods);
+	addBuiltinTable(builtins, &vm->arrayMethods);
+	addBuiltin(builtins, vm->objectClass->name, OBJ_VAL(vm->objectClass));
+	addBuiltin(builtins, vm->importClass->name, OBJ_VAL(vm->importClass));
+	addBuiltin(builtins, vm->iteratorClass->name, OBJ_VAL(vm->iteratorClass));
+	addBuiltin(builtins, vm->exceptionClass->name, OBJ_VAL(vm->exceptionClass));
+}
+
+static void freeBuiltins(Builtins* builtins) {
+	free(builtins->objects);
+	freeObjectIds(&builtins->ids);
+	freeBuffer(&builtins->names);
+}
+
+static uint32_t objectId(SnapshotWriter* writer, Obj* object);
+
+static void writeImageValue(SnapshotWriter* writer, Buffer* buffer, Value value) {
+	if (IS_NULL(value)) bufferWriteU8(buffer, SNAPSHOT_NULL);
+	else if (IS_BOOL(value)) bufferWriteU8(buffer, AS_BOOL(value) ? SNAPSHOT_TRUE : SNAPSHOT_FALSE);
+	else if (IS_NUMBER(value)) {
+		double number = AS_NUMBER(value);
+		uint64_t bits;
+		memcpy(&bits, &number, sizeof(bits));
+		bufferWriteU8(buffer, SNAPSHOT_NUMBER);
+		bufferWriteU64(buffer, bits);
+	}
+	else {
+		uint32_t id;
+		if (getObjectId(&writer->builtins.ids, AS_OBJ(value), &id)) {
+			bufferWriteU8(buffer, SNAPSHOT_BUILTIN);
+		}
+		else {
+			id = objectId(writer, AS_OBJ(value));
+			bufferWriteU8(buffer, SNAPSHOT_OBJECT);
+		}
+		bufferWriteU32(buffer, id);
+	}
+}
+
+static void writeImageObject(SnapshotWriter* writer, Buffer* buffer, Obj* object) {
+	writeImageValue(writer, buffer, object == NULL ? NULL_VAL : OBJ_VAL(object));
+}
+
+static void writeTable(SnapshotWriter* writer, Buffer* buffer, Table* table) {
+	bufferWriteU32(buffer, (uint32_t)table->count);
+	for (int i = 0; i <= table->capacity; i++) {
+		Entry* entry = &table->entries[i];
+		if (entry->key == NULL) continue;
+		writeImageObject(writer, buffer, &entry->key->obj);
+		writeImageValue(writer, buffer, entry->value);
+	}
+}
+
+// Numbers an object the first time it is found and writes its shape. The objects a shape refers to are
+// numbered before it, so they already exist when it is allocated.
+static uint32_t objectId(SnapshotWriter* writer, Obj* object) {
+	uint32_t id;
+	if (getObjectId(&writer->ids, object, &id)) return id;
+
+	uint32_t dependency = 0;
+	switch (object->type) {
+		case OBJ_CLOSURE: dependency = objectId(writer, &((ObjClosure*)object)->function->obj); break;
+		case OBJ_CLASS: dependency = objectId(writer, &((ObjClass*)object)->name->obj); break;
+		case OBJ_NATIVE:
+			writer->error = "native functions other than the builtins";
+			break;
+		case OBJ_FUNCTION:
+			if (((ObjFunction*)object)->module != writer->vm->module) writer->error = "functions from imported modules";
+			break;
+		case OBJ_UPVALUE: {
+			ObjUpvalue* upvalue = (ObjUpvalue*)object;
+			if (upvalue->location != &upvalue->closed) writer->error = "variables of a running function";
+			break;
+		}
+	}
+
+	id = (uint32_t)writer->count;
+	setObjectId(&writer->ids, object, id);
+	appendObject(&writer->objects, &writer->count, &writer->capacity, object);
+
+	Buffer* shapes = &writer->shapes;
+	bufferWriteU8(shapes, object->type);
+
+	switch (object->type) {
+		case OBJ_STRING: {
+			ObjString* string = (ObjString*)object;
+			bufferWriteU32(shapes, (uint32_t)string->length);
+			bufferWrite(shapes, string->chars, string->length);
+			break;
+		}
+		case OBJ_FUNCTION: {
+			ObjFunction* function = (ObjFunction*)object;
+			bufferWriteU8(shapes, (function->lambda ? 1 : 0) | (function->varArgs ? 2 : 0));
+			bufferWriteU32(shapes, (uint32_t)function->arity);
+			bufferWriteU32(shapes, (uint32_t)function->upvalueCount);
+			break;
+		}
+		case OBJ_CLOSURE:
+		case OBJ_CLASS:
+			bufferWriteU32(shapes, dependency);
+			break;
+		case OBJ_ARRAY: {
+			ObjArray* array = (ObjArray*)object;
+			bufferWriteU8(shapes, (uint8_t)array->arrayType);
+			bufferWriteU64(shapes, array->count);
+			bufferWrite(shapes, (const char*)array->data, array->count * arrayElementSize(array->arrayType));
+			break;
+		}
+	}
+	return id;
+}
+
+static void writeContents(SnapshotWriter* writer, Obj* object) {
+	Buffer* buffer = &writer->contents;
+
+	switch (object->type) {
+		case OBJ_FUNCTION: {
+			ObjFunction* function = (ObjFunction*)object;
+			writeImageObject(writer, buffer, function->name == NULL ? NULL : &function->name->obj);
+
+			Chunk* chunk = &function->chunk;
+			bufferWriteU32(buffer, (uint32_t)chunk->count);
+			bufferWrite(buffer, (const char*)chunk->code, chunk->count);
+
+			bufferWriteU32(buffer, (uint32_t)chunk->table.count);
+			for (size_t i = 0; i < chunk->table.count; i++) bufferWriteU64(buffer, chunk->table.lines[i]);
+
+			bufferWriteU32(buffer, (uint32_t)chunk->constants.count);
+			for (size_t i = 0; i < chunk->constants.count; i++) writeImageValue(writer, buffer, chunk->constants.values[i]);
+			break;
+		}
+		case OBJ_CLOSURE: {
+			ObjClosure* closure = (ObjClosure*)object;
+			for (size_t i = 0; i < closure->upvalueCount; i++) writeImageObject(writer, buffer, (Obj*)closure->upvalues[i]);
+			break;
+		}
+		case OBJ_UPVALUE:
+			writeImageValue(writer, buffer, ((ObjUpvalue*)object)->closed);
+			break;
+		case OBJ_CLASS:
+			writeTable(writer, buffer, &((ObjClass*)object)->methods);
+			break;
+		case OBJ_INSTANCE: {
+			ObjInstance* instance = (ObjInstance*)object;
+			writeImageObject(writer, buffer, &instance->class->obj);
+			writeTable(writer, buffer, &instance->fields);
+			break;
+		}
+		case OBJ_BOUND_METHOD: {
+			ObjBoundMethod* bound = (ObjBoundMethod*)object;
+			writeImageValue(writer, buffer, bound->receiver);
+			writeImageObject(writer, buffer, &bound->method->obj);
+			break;
+		}
+		case OBJ_LIST: {
+			ValueArray* items = &((ObjList*)object)->items;
+			bufferWriteU32(buffer, (uint32_t)items->count);
+			for (size_t i = 0; i < items->count; i++) writeImageValue(writer, buffer, items->values[i]);
+			break;
+		}
+		case OBJ_MAP: {
+			ValueTable* items = &((ObjMap*)object)->items;
+			bufferWriteU32(&writer->mapContents, (uint32_t)items->count);
+			for (int i = 0; i <= items->capacity; i++) {
+				if (!CTRL_IS_FULL(items->control[i])) continue;
+				writeImageValue(writer, &writer->mapContents, items->entries[i].key);
+				writeImageValue(writer, &writer->mapContents, items->entries[i].value);
+			}
+			break;
+		}
+	}
+}
+
+// Writes to a temporary file first, so that a VM starting meanwhile never sees the image half written.
+static bool writeImage(const char* path, Buffer* image) {
+	size_t pathLength = strlen(path);
+	char* tempPath = malloc(pathLength + 5);
+	memcpy(tempPath, path, pathLength);
+	strcpy(tempPath + pathLength, ".tmp");
+
+	bool isWritten = false;
+	FILE* file = fopen(tempPath, "wb");
+	if (file != NULL) {
+		isWritten = fwrite(image->chars, 1, image->length, file) == image->length;
+		isWritten = fclose(file) == 0 && isWritten;
+
+#if defined(_WIN32) || defined(_WIN64) || defined(WINDOWS)
+		remove(path); // Windows will not rename over an existing file.
+#endif
+		if (!isWritten || rename(tempPath, path) != 0) {
+			remove(tempPath);
+			isWritten = false;
+		}
+	}
+
+	free(tempPath);
+	return isWritten;
+}
+
+// _NAME differs between the VM making the image and the ones loading it, so is never saved.
+static bool isSavedGlobal(VM* vm, ObjString* name, Value value) {
+	if (name->length == 5 && memcmp(name->chars, "_NAME", 5) == 0) return false;
+
+	Value builtin;
+	return !tableGet(&vm->builtins, name, &builtin) || !valuesEqual(builtin, value);
+}
+
+// Nothing here allocates from the heap, so the objects being written need no rooting.
+bool writeSnapshot(VM* vm, const char* path) {
+	SnapshotWriter writer;
+	writer.vm = vm;
+	findBuiltins(vm, &writer.builtins);
+	initObjectIds(&writer.ids);
+	writer.count = 0;
+	writer.capacity = 0;
+	writer.objects = NULL;
+	initBuffer(&writer.shapes);
+	initBuffer(&writer.contents);
+	initBuffer(&writer.mapContents);
+	writer.error = NULL;
+
+	Table* globals = &vm->module->globals;
+	Buffer roots;
+	initBuffer(&roots);
+
+	uint32_t rootCount = 0;
+	for (int i = 0; i <= globals->capacity; i++) {
+		Entry* entry = &globals->entries[i];
+		if (entry->key != NULL && isSavedGlobal(vm, entry->key, entry->value)) rootCount++;
+	}
+	bufferWriteU32(&roots, rootCount);
+	for (int i = 0; i <= globals->capacity; i++) {
+		Entry* entry = &globals->entries[i];
+		if (entry->key == NULL || !isSavedGlobal(vm, entry->key, entry->value)) continue;
+		writeImageObject(&writer, &roots, &entry->key->obj);
+		writeImageValue(&writer, &roots, entry->value);
+	}
+
+	// Writing the contents of an object finds the objects it refers to, so the count grows as this runs.
+	for (size_t i = 0; i < writer.count; i++) writeContents(&writer, writer.objects[i]);
+
+	bool isWritten = false;
+	if (writer.error != NULL) {
+		fprintf(stderr, "Cannot snapshot %s.\n", writer.error);
+	}
+	else {
+		Buffer image;
+		initBuffer(&image);
+
+		SnapshotHeader header;
+		memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+		header.version = SNAPSHOT_VERSION;
+		header.bytecodeVersion = BYTECODE_VERSION;
+		header.builtinCount = (uint32_t)writer.builtins.count;
+		header.builtinsHash = hashBytes(writer.builtins.names.chars, writer.builtins.names.length);
+		header.bodyHash = 0;
+		bufferWrite(&image, (const char*)&header, sizeof(header));
+
+		bufferWriteU32(&image, (uint32_t)writer.count);
+		bufferWrite(&image, writer.shapes.chars, writer.shapes.length);
+		bufferWrite(&image, writer.contents.chars, writer.contents.length);
+		bufferWrite(&image, writer.mapContents.chars, writer.mapContents.length);
+		bufferWrite(&image, roots.chars, roots.length);
+
+		header.bodyHash = hashBytes(image.chars + sizeof(header), image.length - sizeof(header));
+		memcpy(image.chars, &header, sizeof(header));
+
+		isWritten = writeImage(path, &image);
+		if (!isWritten) fprintf(stderr, "Could not write snapshot '%s'.\n", path);
+		freeBuffer(&image);
+	}
+
+	freeBuffer(&roots);
+	freeBuffer(&writer.shapes);
+	freeBuffer(&writer.contents);
+	freeBuffer(&writer.mapContents);
+	free(writer.objects);
+	freeObjectIds(&writer.ids);
+	freeBuiltins(&writer.builtins);
+	return isWritten;
+}
+
+static Value readImageValue(SnapshotReader* reader) {
+	switch (readU8(&reader->reader)) {
+		case SNAPSHOT_NULL: return NULL_VAL;
+		case SNAPSHOT_FALSE: return BOOL_VAL(false);
+		case SNAPSHOT_TRUE: return BOOL_VAL(true);
+		case SNAPSHOT_NUMBER: {
+			uint64_t bits = readU64(&reader->reader);
+			double number;
+			memcpy(&number, &bits, sizeof(number));
+			return NUMBER_VAL(number);
+		}
+		case SNAPSHOT_OBJECT: {
+			uint32_t id = readU32(&reader->reader);
+			if (id < reader->objects->items.count) return reader->objects->items.values[id];
+			break;
+		}
+		case SNAPSHOT_BUILTIN: {
+			uint32_t id = readU32(&reader->reader);
+			if (id < reader->builtins->count) return OBJ_VAL(reader->builtins->objects[id]);
+			break;
+		}
+	}
+	reader->reader.isError = true;
+	return NULL_VAL;
+}
+
+// Reads a reference to an object of the given type, which may be NULL if isOptional.
+static Obj* readImageObject(SnapshotReader* reader, ObjType type, bool isOptional) {
+	Value value = readImageValue(reader);
+	if (IS_NULL(value) && isOptional) return NULL;
+	if (!isObjType(value, type)) {
+		reader->reader.isError = true;
+		return NULL;
+	}
+	return AS_OBJ(value);
+}
+
+// Shapes only refer to objects read before them.
+static Obj* readEarlierObject(SnapshotReader* reader, ObjType type) {
+	uint32_t id = readU32(&reader->reader);
+	if (id >= reader->objects->items.count || !isObjType(reader->objects->items.values[id], type)) {
+		reader->reader.isError = true;
+		return NULL;
+	}
+	return AS_OBJ(reader->objects->items.values[id]);
+}
+
+static void readTable(SnapshotReader* reader, Table* table) {
+	uint32_t count = readU32(&reader->reader);
+	for (uint32_t i = 0; i < count && !reader->reader.isError; i++) {
+		ObjString* key = (ObjString*)readImageObject(reader, OBJ_STRING, false);
+		Value value = readImageValue(reader);
+		if (!reader->reader.isError) tableSet(reader->vm, table, key, value);
+	}
+}
+
+// Allocates an object from its shape. Whatever it refers to is filled in once every object exists.
+static Obj* readShape(SnapshotReader* reader) {
+	VM* vm = reader->vm;
+	Reader* bytes = &reader->reader;
+
+	switch (readU8(bytes)) {
+		case OBJ_STRING: {
+			uint32_t length = readU32(bytes);
+			const uint8_t* chars = readBytes(bytes, length);
+			if (chars == NULL) return NULL;
+			return &copyString(vm, (const char*)chars, length)->obj;
+		}
+		case OBJ_FUNCTION: {
+			uint8_t flags = readU8(bytes);
+			ObjFunction* function = newFunction(vm);
+			function->lambda = (flags & 1) != 0;
+			function->varArgs = (flags & 2) != 0;
+			function->arity = readU32(bytes);
+			function->upvalueCount = readU32(bytes);
+			if (function->upvalueCount > UINT8_MAX + 1) bytes->isError = true;
+			return &function->obj;
+		}
+		case OBJ_CLOSURE: {
+			ObjFunction* function = (ObjFunction*)readEarlierObject(reader, OBJ_FUNCTION);
+			if (function == NULL) return NULL;
+			return &newClosure(vm, function)->obj;
+		}
+		case OBJ_UPVALUE: {
+			ObjUpvalue* upvalue = newUpvalue(vm, NULL);
+			upvalue->location = &upvalue->closed;
+			return &upvalue->obj;
+		}
+		case OBJ_CLASS: {
+			ObjString* name = (ObjString*)readEarlierObject(reader, OBJ_STRING);
+			if (name == NULL) return NULL;
+			return &newClass(vm, name)->obj;
+		}
+		case OBJ_INSTANCE: return &newInstance(vm, NULL)->obj;
+		case OBJ_BOUND_METHOD: return &newBoundMethod(vm, NULL_VAL, NULL)->obj;
+		case OBJ_LIST: {
+			ValueArray items;
+			initValueArray(&items);
+			return &newList(vm, items)->obj;
+		}
+		case OBJ_MAP: return &newMap(vm)->obj;
+		case OBJ_ARRAY: {
+			ArrayType type = readU8(bytes);
+			uint64_t count = readU64(bytes);
+			if (type > ARRAY_UINT8 || count > bytes->length) break;
+
+			const uint8_t* data = readBytes(bytes, count * arrayElementSize(type));
+			if (data == NULL) return NULL;
+
+			ObjArray* array = newArray(vm, type, count);
+			if (count > 0) memcpy(array->data, data, count * arrayElementSize(type));
+			return &array->obj;
+		}
+	}
+
+	bytes->isError = true;
+	return NULL;
+}
+
+// Objects may be old by now, so each reference stored in one goes through the write barrier.
+static void readContents(SnapshotReader* reader, Obj* object) {
+	VM* vm = reader->vm;
+	Reader* bytes = &reader->reader;
+
+	switch (object->type) {
+		case OBJ_FUNCTION: {
+			ObjFunction* function = (ObjFunction*)object;
+			function->name = (ObjString*)readImageObject(reader, OBJ_STRING, true);
+			if (function->name != NULL) writeBarrier(vm, object, OBJ_VAL(function->name));
+
+			Chunk* chunk = &function->chunk;
+			size_t codeCount = readU32(bytes);
+			const uint8_t* code = readBytes(bytes, codeCount);
+			if (code != NULL && codeCount > 0) {
+				chunk->code = ALLOCATE(vm, uint8_t, codeCount);
+				memcpy(chunk->code, code, codeCount);
+				chunk->count = codeCount;
+				chunk->capacity = codeCount;
+			}
+
+			size_t lineCount = readU32(bytes);
+			if (!bytes->isError && lineCount > 0 && lineCount <= (bytes->length - bytes->offset) / sizeof(uint64_t)) {
+				chunk->table.lines = ALLOCATE(vm, size_t, lineCount);
+				chunk->table.capacity = lineCount;
+				for (size_t i = 0; i < lineCount; i++) chunk->table.lines[i] = (size_t)readU64(bytes);
+				chunk->table.count = lineCount;
+			}
+			else if (lineCount > 0) {
+				bytes->isError = true;
+			}
+
+			size_t constantCount = readU32(bytes);
+			for (size_t i = 0; i < constantCount && !bytes->isError; i++) {
+				Value constant = readImageValue(reader);
+				if (!bytes->isError) addConstant(vm, chunk, constant);
+			}
+			break;
+		}
+		case OBJ_CLOSURE: {
+			ObjClosure* closure = (ObjClosure*)object;
+			for (size_t i = 0; i < closure->upvalueCount; i++) {
+				closure->upvalues[i] = (ObjUpvalue*)readImageObject(reader, OBJ_UPVALUE, true);
+				if (closure->upvalues[i] != NULL) writeBarrier(vm, object, OBJ_VAL(closure->upvalues[i]));
+			}
+			break;
+		}
+		case OBJ_UPVALUE: {
+			ObjUpvalue* upvalue = (ObjUpvalue*)object;
+			upvalue->closed = readImageValue(reader);
+			writeBarrier(vm, object, upvalue->closed);
+			break;
+		}
+		case OBJ_CLASS:
+			readTable(reader, &((ObjClass*)object)->methods);
+			break;
+		case OBJ_INSTANCE: {
+			ObjInstance* instance = (ObjInstance*)object;
+			instance->class = (ObjClass*)readImageObject(reader, OBJ_CLASS, false);
+			if (instance->class != NULL) writeBarrier(vm, object, OBJ_VAL(instance->class));
+			readTable(reader, &instance->fields);
+			break;
+		}
+		case OBJ_BOUND_METHOD: {
+			ObjBoundMethod* bound = (ObjBoundMethod*)object;
+			bound->receiver = readImageValue(reader);
+			writeBarrier(vm, object, bound->receiver);
+			bound->method = (ObjClosure*)readImageObject(reader, OBJ_CLOSURE, false);
+			if (bound->method != NULL) writeBarrier(vm, object, OBJ_VAL(bound->method));
+			break;
+		}
+		case OBJ_LIST: {
+			ObjList* list = (ObjList*)object;
+			uint32_t count = readU32(bytes);
+			for (uint32_t i = 0; i < count && !bytes->isError; i++) {
+				Value item = readImageValue(reader);
+				if (!bytes->isError) writeValueArray(vm, &list->items, item);
+			}
+			break;
+		}
+	}
+}
+
+static void readMapContents(SnapshotReader* reader, ObjMap* map) {
+	uint32_t count = readU32(&reader->reader);
+	for (uint32_t i = 0; i < count && !reader->reader.isError; i++) {
+		Value key = readImageValue(reader);
+		Value value = readImageValue(reader);
+		if (!reader->reader.isError && !isHashable(key)) reader->reader.isError = true;
+		if (!reader->reader.isError) valueTableSet(reader->vm, &map->items, key, value);
+	}
+}
+
+static bool readImage(VM* vm, const uint8_t* body, size_t length, Builtins* builtins) {
+	SnapshotReader reader;
+	reader.vm = vm;
+	reader.builtins = builtins;
+	initReader(&reader.reader, body, length);
+
+	ValueArray empty;
+	initValueArray(&empty);
+	reader.objects = newList(vm, empty);
+	push(vm, OBJ_VAL(reader.objects));
+
+	// Every object takes at least a byte, so a damaged count cannot run on much past the end.
+	uint32_t count = readU32(&reader.reader);
+	if (count > length) reader.reader.isError = true;
+
+	for (uint32_t i = 0; i < count && !reader.reader.isError; i++) {
+		Obj* object = readShape(&reader);
+		if (object == NULL) break;
+
+		push(vm, OBJ_VAL(object)); // Growing the list may collect.
+		writeValueArray(vm, &reader.objects->items, OBJ_VAL(object));
+		pop(vm);
+	}
+
+	for (uint32_t i = 0; i < count && !reader.reader.isError; i++) {
+		readContents(&reader, AS_OBJ(reader.objects->items.values[i]));
+	}
+
+	for (uint32_t i = 0; i < count && !reader.reader.isError; i++) {
+		Obj* object = AS_OBJ(reader.objects->items.values[i]);
+		if (object->type == OBJ_MAP) readMapContents(&reader, (ObjMap*)object);
+	}
+
+	// The globals are only defined once the whole image has been read.
+	size_t firstRoot = reader.objects->items.count;
+	uint32_t rootCount = readU32(&reader.reader);
+	for (uint32_t i = 0; i < rootCount && !reader.reader.isError; i++) {
+		Obj* name = readImageObject(&reader, OBJ_STRING, false);
+		Value value = readImageValue(&reader);
+		if (reader.reader.isError) break;
+		writeValueArray(vm, &reader.objects->items, OBJ_VAL(name));
+		writeValueArray(vm, &reader.objects->items, value);
+	}
+
+	bool isRead = !reader.reader.isError && reader.reader.offset == reader.reader.length;
+	if (isRead) {
+		for (size_t i = firstRoot; i < reader.objects->items.count; i += 2) {
+			Value* root = &reader.objects->items.values[i];
+			tableSet(vm, &vm->module->globals, AS_STRING(root[0]), root[1]);
+		}
+	}
+
+	pop(vm);
+	return isRead;
+}
+
+bool loadSnapshot(VM* vm, const char* path) {
+	File file = readFile(path);
+	if (file.isError) {
+		free(file.contents);
+		return false;
+	}
+
+	bool isLoaded = false;
+
+	SnapshotHeader header;
+	if (file.length >= sizeof(header)) {
+		memcpy(&header, file.contents, sizeof(header));
+
+		const uint8_t* body = (const uint8_t*)file.contents + sizeof(header);
+		size_t bodyLength = file.length - sizeof(header);
+
+		if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) == 0 && header.version == SNAPSHOT_VERSION
+			&& header.bytecodeVersion == BYTECODE_VERSION && header.bodyHash == hashBytes(body, bodyLength)) {
+			Builtins builtins;
+			findBuiltins(vm, &builtins);
+
+			if (header.builtinCount == builtins.count && header.builtinsHash == hashBytes(builtins.names.chars, builtins.names.length)) {
+				isLoaded = readImage(vm, body, bodyLength, &builtins);
+			}
+			freeBuiltins(&builtins);
+		}
+	}
+
+	free(file.contents);
+	return isLoaded;
+}
\ No newline at end of file
@@ -0,0 +1,22 @@
+#pragma once
+#include <core/common.h>
+#include <vm/vm.h>
+
+// Images only load into the same version of the format, with the same builtins. Bump it whenever the
+// format changes.
+#define SNAPSHOT_VERSION 1
+
+// Saves the globals the main module has defined beyond the builtins, and everything they reference, to an
+// image at path. Builtins are referred to by their place among the VM's builtins rather than copied.
+// Returns false, having reported why, if the globals hold something an image cannot or path cannot be written.
+bool writeSnapshot(VM* vm, const char* path);
+
+// Defines the globals saved in the image at path in the main module. Returns false, leaving the module
+// unchanged, if the image is missing, damaged or was made by another build.
+bool loadSnapshot(VM* vm, const char* path);
+
+// Sets the image every new VM starts from, from FOX_SNAPSHOT or --snapshot.
+bool setStartupSnapshot(const char* path);
+
+// NULL when no image is set.
+const char* startupSnapshot();
\ No newline at end of file
@@ -6,42 +6,152 @@
 #include <string.h>
 #include <stdio.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FOX_TABLE_SSE2
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 #define TABLE_MAX_LOAD 0.75
+// Rehashing sizes the table so live entries sit at or below this load.
+#define TABLE_REHASH_LOAD 0.5
+// Compacting shrinks tables below this load, or with more than this share of tombstones.
+#define TABLE_MIN_LOAD 0.125
+#define TABLE_MAX_TOMBSTONES 0.25
+
+// The hash is split in two, H1 selects the group to start probing from and H2 is stored in the control byte.
+#define H1(hash) ((hash) >> 7)
+#define H2(hash) ((uint8_t)((hash) & 0x7F))
+
+static inline size_t controlSize(int capacity) {
+	size_t size = (size_t)capacity + 1;
+	return size < TABLE_GROUP_WIDTH ? TABLE_GROUP_WIDTH : size;
+}
+
+// Capacity is always one less than a power of two, so this is the group count minus one.
+static inline size_t groupMask(int capacity) {
+	return (size_t)capacity / TABLE_GROUP_WIDTH;
+}
+
+// Tables smaller than a group only use the low bits of each match.
+static inline uint32_t validMask(int capacity) {
+	return capacity >= TABLE_GROUP_WIDTH - 1 ? 0xFFFF : (2u << capacity) - 1;
+}
+
+static inline int firstBit(uint32_t mask) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return (int)index;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+// Returns a bitmask of the bytes in the group equal to byte.
+static inline uint32_t matchByte(const uint8_t* group, uint8_t byte) {
+#ifdef FOX_TABLE_SSE2
+	__m128i ctrl = _mm_loadu_si128((const __m128i*)group);
+	return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)byte)));
+#else
+	uint32_t mask = 0;
+	for (int i = 0; i < TABLE_GROUP_WIDTH; i++) {
+		if (group[i] == byte) mask |= 1u << i;
+	}
+	return mask;
+#endif
+}
+
+// Empty and deleted are the only control bytes with the high bit set.
+static inline uint32_t matchEmptyOrDeleted(const uint8_t* group) {
+#ifdef FOX_TABLE_SSE2
+	return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)group));
+#else
+	uint32_t mask = 0;
+	for (int i = 0; i < TABLE_GROUP_WIDTH; i++) {
+		if (group[i] & 0x80) mask |= 1u << i;
+	}
+	return mask;
+#endif
+}
 
 void initTable(Table* table) {
 	table->count = 0;
+	table->tombstones = 0;
 	table->capacity = -1;
+	table->control = NULL;
 	table->entries = NULL;
+	table->owner = NULL;
 }
 
 void freeTable(VM* vm, Table* table) {
 	FREE_ARRAY(vm, Entry, table->entries, table->capacity + 1);
+	if (table->control != NULL) FREE_ARRAY(vm, uint8_t, table->control, controlSize(table->capacity));
 	initTable(table);
 }
 
-static Entry* findEntry(Entry* entries, int capacity, ObjString* key) {
-	uint32_t index = key->hash & capacity;
-	Entry* tombstone = NULL;
+// Returns the entry holding key, or NULL if it is not present.
+static inline Entry* findEntry(Table* table, ObjString* key) {
+	size_t mask = groupMask(table->capacity);
+	uint32_t valid = validMask(table->capacity);
+	uint8_t h2 = H2(key->hash);
 
-	for (;;) {
-		Entry* entry = &entries[index];
+	size_t group = H1(key->hash) & mask;
 
-		if (entry->key == NULL) {
-			if (IS_NULL(entry->value)) {
-				// Empty entry.
-				return tombstone != NULL ? tombstone : entry;
-			}
-			else {
-				// We found a tombstone.
-				if (tombstone == NULL) tombstone = entry;
-			}
+	for (size_t probe = 1;; probe++) {
+		size_t base = group * TABLE_GROUP_WIDTH;
+		const uint8_t* ctrl = &table->control[base];
+
+		uint32_t match = matchByte(ctrl, h2) & valid;
+		while (match != 0) {
+			Entry* entry = &table->entries[base + firstBit(match)];
+			if (entry->key == key) return entry;
+			match &= match - 1;
+		}
+
+		if (matchByte(ctrl, CTRL_EMPTY) & valid) return NULL;
+
+		group = (group + probe) & mask;
+	}
+}
+
+// Returns the index of the key if it is present, otherwise the first empty or deleted slot in its probe sequence.
+static size_t findSlot(uint8_t* control, Entry* entries, int capacity, ObjString* key) {
+	size_t mask = groupMask(capacity);
+	uint32_t valid = validMask(capacity);
+	uint8_t h2 = H2(key->hash);
+
+	size_t group = H1(key->hash) & mask;
+	size_t insert = 0;
+	bool foundInsert = false;
+
+	for (size_t probe = 1;; probe++) {
+		size_t base = group * TABLE_GROUP_WIDTH;
+		const uint8_t* ctrl = &control[base];
+
+		uint32_t match = matchByte(ctrl, h2) & valid;
+		while (match != 0) {
+			size_t index = base + firstBit(match);
+			if (entries[index].key == key) return index;
+			match &= match - 1;
 		}
-		else if (entry->key == key) {
-			// We found the key.
-			return entry;
+
+		if (!foundInsert) {
+			uint32_t available = matchEmptyOrDeleted(ctrl) & valid;
+			if (available != 0) {
+				insert = base + firstBit(available);
+				foundInsert = true;
+			}
 		}
 
-		index = (index + 1) & capacity;
+		// An empty slot ends the probe sequence, the key cannot be further along.
+		if (matchByte(ctrl, CTRL_EMPTY) & valid) return insert;
+
+		// Triangular probing visits every group when the group count is a power of two.
+		group = (group + probe) & mask;
 	}
 }
 
@@ -52,44 +162,71 @@ static void adjustCapacity(VM* vm, Table* table, int capacity) {
 		entries[i].value = NULL_VAL;
 	}
 
+	uint8_t* control = ALLOCATE(vm, uint8_t, controlSize(capacity));
+	memset(control, CTRL_EMPTY, controlSize(capacity));
+
 	table->count = 0;
+	table->tombstones = 0;
 	for (int i = 0; i <= table->capacity; i++) {
 		Entry* entry = &table->entries[i];
 		if (entry->key == NULL) continue;
 
-		Entry* dest = findEntry(entries, capacity, entry->key);
-		dest->key = entry->key;
-		dest->value = entry->value;
+		size_t index = findSlot(control, entries, capacity, entry->key);
+		entries[index].key = entry->key;
+		entries[index].value = entry->value;
+		control[index] = H2(entry->key->hash);
 		table->count++;
 	}
 
 	FREE_ARRAY(vm, Entry, table->entries, table->capacity + 1);
+	if (table->control != NULL) FREE_ARRAY(vm, uint8_t, table->control, controlSize(table->capacity));
 
 	table->entries = entries;
+	table->control = control;
 	table->capacity = capacity;
 }
 
+// The smallest capacity which holds count entries at the rehash load.
+static int capacityFor(int count) {
+	int size = 8;
+	while (count > size * TABLE_REHASH_LOAD) size *= 2;
+	return size - 1;
+}
+
 bool tableSet(VM* vm, Table* table, ObjString* key, Value value) {
-	if (table->count + 1 > (table->capacity + 1) * TABLE_MAX_LOAD) {
-		int capacity = (table->capacity + 1 < 8 ? 8 : (table->capacity + 1) * 2) - 1;
-		adjustCapacity(vm, table, capacity);
+	// Tombstones take up probe slots, so they count toward the load. Sizing the rehash from the
+	// live count alone means a table full of tombstones is cleaned rather than doubled.
+	if (table->count + table->tombstones + 1 > (table->capacity + 1) * TABLE_MAX_LOAD) {
+		// Growing can collect, and the key and value are often not rooted anywhere yet.
+		push(vm, OBJ_VAL(key));
+		push(vm, value);
+		adjustCapacity(vm, table, capacityFor(table->count + 1));
+		pop(vm);
+		pop(vm);
 	}
 
-	Entry* entry = findEntry(table->entries, table->capacity, key);
+	size_t index = findSlot(table->control, table->entries, table->capacity, key);
+	Entry* entry = &table->entries[index];
 
 	bool isNewKey = entry->key == NULL;
-	if (isNewKey && IS_NULL(entry->value)) table->count++;
+	if (isNewKey) {
+		table->count++;
+		if (table->control[index] == CTRL_DELETED) table->tombstones--;
+	}
 
 	entry->key = key;
 	entry->value = value;
+	table->control[index] = H2(key->hash);
+	writeBarrier(vm, table->owner, OBJ_VAL(key));
+	writeBarrier(vm, table->owner, value);
 	return isNewKey;
 }
 
 bool tableGet(Table* table, ObjString* key, Value* value) {
 	if (table->count == 0) return false;
 
-	Entry* entry = findEntry(table->entries, table->capacity, key);
-	if (entry->key == NULL) return false;
+	Entry* entry = findEntry(table, key);
+	if (entry == NULL) return false;
 
 	*value = entry->value;
 	return true;
@@ -99,12 +236,24 @@ bool tableDelete(Table* table, ObjString* key) {
 	if (table->count == 0) return false;
 
 	// Find the entry.
-	Entry* entry = findEntry(table->entries, table->capacity, key);
-	if (entry->key == NULL) return false;
+	Entry* entry = findEntry(table, key);
+	if (entry == NULL) return false;
 
-	// Place a tombstone in the entry.
+	size_t index = entry - table->entries;
 	entry->key = NULL;
-	entry->value = BOOL_VAL(true);
+	entry->value = NULL_VAL;
+	table->count--;
+
+	// Probing stops at the first group with an empty slot, so if this group has one
+	// no probe sequence can pass through it and the slot can be emptied rather than tombstoned.
+	size_t base = index - (index % TABLE_GROUP_WIDTH);
+	if (matchByte(&table->control[base], CTRL_EMPTY) & validMask(table->capacity)) {
+		table->control[index] = CTRL_EMPTY;
+	}
+	else {
+		table->control[index] = CTRL_DELETED;
+		table->tombstones++;
+	}
 
 	return true;
 }
@@ -112,35 +261,48 @@ bool tableDelete(Table* table, ObjString* key) {
 ObjString* tableFindString(Table* table, const char* chars, size_t length, uint32_t hash) {
 	if (table->count == 0) return NULL;
 
-	uint32_t index = hash & table->capacity;
+	size_t mask = groupMask(table->capacity);
+	uint32_t valid = validMask(table->capacity);
+	uint8_t h2 = H2(hash);
 
-	for (;;) {
+	size_t group = H1(hash) & mask;
 
-		Entry* entry = &table->entries[index];
+	for (size_t probe = 1;; probe++) {
+		size_t base = group * TABLE_GROUP_WIDTH;
+		const uint8_t* ctrl = &table->control[base];
 
-		if (entry->key == NULL) {
-			// Stop if we find an empty non-tombstone entry.
-			if (IS_NULL(entry->value)) return NULL;
-		}
-		else if (entry->key->length == length && entry->key->hash == hash && memcmp(entry->key->chars, chars, length) == 0) {
-			// We found it.
-			return entry->key;
+		uint32_t match = matchByte(ctrl, h2) & valid;
+		while (match != 0) {
+			ObjString* key = table->entries[base + firstBit(match)].key;
+			if (key->length == length && key->hash == hash && memcmp(key->chars, chars, length) == 0) {
+				// We found it.
+				return key;
+			}
+			match &= match - 1;
 		}
 
-		index = (index + 1) & table->capacity;
+		// Stop if we find an empty non-tombstone entry.
+		if (matchByte(ctrl, CTRL_EMPTY) & valid) return NULL;
+
+		group = (group + probe) & mask;
 	}
 	return NULL;
 }
 
-void tableRemoveWhite(Table* table) {
+// Rehashes a table which has become sparse or filled with tombstones, shrinking it where possible.
+void tableCompact(VM* vm, Table* table) {
+	if (table->capacity == -1) return;
 
-	for (int i = 0; i <= table->capacity; i++) {
-		Entry* entry = &table->entries[i];
-		if (entry->key != NULL && !entry->key->obj.isMarked) {
-			tableDelete(table, entry->key);
-		}
+	if (table->count == 0) {
+		freeTable(vm, table);
+		return;
 	}
 
+	int size = table->capacity + 1;
+	bool sparse = size > 8 && table->count < size * TABLE_MIN_LOAD;
+	if (sparse || table->tombstones > size * TABLE_MAX_TOMBSTONES) {
+		adjustCapacity(vm, table, capacityFor(table->count));
+	}
 }
 
 void tableAddAll(VM* vm, Table* from, Table* to) {
@@ -150,4 +312,197 @@ void tableAddAll(VM* vm, Table* from, Table* to) {
 			tableSet(vm, to, entry->key, entry->value);
 		}
 	}
+}
+
+void initValueTable(ValueTable* table) {
+	table->count = 0;
+	table->tombstones = 0;
+	table->capacity = -1;
+	table->control = NULL;
+	table->entries = NULL;
+	table->owner = NULL;
+}
+
+void freeValueTable(VM* vm, ValueTable* table) {
+	FREE_ARRAY(vm, ValueEntry, table->entries, table->capacity + 1);
+	if (table->control != NULL) FREE_ARRAY(vm, uint8_t, table->control, controlSize(table->capacity));
+	initValueTable(table);
+}
+
+// As findSlot, but the index of the key is returned in found if it is present.
+static size_t findValueSlot(uint8_t* control, ValueEntry* entries, int capacity, Value key, uint32_t hash, bool* found) {
+	size_t mask = groupMask(capacity);
+	uint32_t valid = validMask(capacity);
+	uint8_t h2 = H2(hash);
+
+	size_t group = H1(hash) & mask;
+	size_t insert = 0;
+	bool foundInsert = false;
+
+	for (size_t probe = 1;; probe++) {
+		size_t base = group * TABLE_GROUP_WIDTH;
+		const uint8_t* ctrl = &control[base];
+
+		uint32_t match = matchByte(ctrl, h2) & valid;
+		while (match != 0) {
+			size_t index = base + firstBit(match);
+			if (entries[index].hash == hash && valuesEqual(entries[index].key, key)) {
+				*found = true;
+				return index;
+			}
+			match &= match - 1;
+		}
+
+		if (!foundInsert) {
+			uint32_t available = matchEmptyOrDeleted(ctrl) & valid;
+			if (available != 0) {
+				insert = base + firstBit(available);
+				foundInsert = true;
+			}
+		}
+
+		if (matchByte(ctrl, CTRL_EMPTY) & valid) {
+			*found = false;
+			return insert;
+		}
+
+		group = (group + probe) & mask;
+	}
+}
+
+static void adjustValueCapacity(VM* vm, ValueTable* table, int capacity) {
+	ValueEntry* entries = ALLOCATE(vm, ValueEntry, capacity + 1);
+
+	uint8_t* control = ALLOCATE(vm, uint8_t, controlSize(capacity));
+	memset(control, CTRL_EMPTY, controlSize(capacity));
+
+	for (int i = 0; i <= table->capacity; i++) {
+		if (!CTRL_IS_FULL(table->control[i])) continue;
+
+		ValueEntry* entry = &table->entries[i];
+		bool found;
+		size_t index = findValueSlot(control, entries, capacity, entry->key, entry->hash, &found);
+		entries[index] = *entry;
+		control[index] = H2(entry->hash);
+	}
+
+	FREE_ARRAY(vm, ValueEntry, table->entries, table->capacity + 1);
+	if (table->control != NULL) FREE_ARRAY(vm, uint8_t, table->control, controlSize(table->capacity));
+
+	table->tombstones = 0;
+	table->entries = entries;
+	table->control = control;
+	table->capacity = capacity;
+}
+
+// Copies a list key, and the lists nested in it, so changing the list the caller holds afterwards cannot
+// change the hash its entry was stored under.
+static Value copyListKey(VM* vm, Value key) {
+	if (!IS_LIST(key)) return key;
+
+	ObjList* list = AS_LIST(key);
+	push(vm, key);
+
+	ValueArray items;
+	initValueArray(&items);
+	ObjList* copy = newList(vm, items);
+	push(vm, OBJ_VAL(copy));
+
+	for (size_t i = 0; i < list->items.count; i++) {
+		Value item = copyListKey(vm, list->items.values[i]);
+		push(vm, item);
+		writeValueArray(vm, &copy->items, item);
+		pop(vm);
+	}
+
+	pop(vm);
+	pop(vm);
+	return OBJ_VAL(copy);
+}
+
+bool valueTableSet(VM* vm, ValueTable* table, Value key, Value value) {
+	Value existing;
+	if (IS_LIST(key) && !valueTableGet(table, key, &existing)) {
+		push(vm, value);
+		key = copyListKey(vm, key);
+		pop(vm);
+	}
+
+	if (table->count + table->tombstones + 1 > (table->capacity + 1) * TABLE_MAX_LOAD) {
+		push(vm, key);
+		push(vm, value);
+		adjustValueCapacity(vm, table, capacityFor(table->count + 1));
+		pop(vm);
+		pop(vm);
+	}
+
+	uint32_t hash = hashValue(key);
+	bool found;
+	size_t index = findValueSlot(table->control, table->entries, table->capacity, key, hash, &found);
+	ValueEntry* entry = &table->entries[index];
+
+	if (!found) {
+		table->count++;
+		if (table->control[index] == CTRL_DELETED) table->tombstones--;
+		entry->key = key;
+		entry->hash = hash;
+		table->control[index] = H2(hash);
+	}
+
+	entry->value = value;
+	writeBarrier(vm, table->owner, key);
+	writeBarrier(vm, table->owner, value);
+	return !found;
+}
+
+bool valueTableGet(ValueTable* table, Value key, Value* value) {
+	if (table->count == 0) return false;
+
+	bool found;
+	size_t index = findValueSlot(table->control, table->entries, table->capacity, key, hashValue(key), &found);
+	if (!found) return false;
+
+	*value = table->entries[index].value;
+	return true;
+}
+
+bool valueTableDelete(ValueTable* table, Value key) {
+	if (table->count == 0) return false;
+
+	bool found;
+	size_t index = findValueSlot(table->control, table->entries, table->capacity, key, hashValue(key), &found);
+	if (!found) return false;
+
+	table->entries[index].key = NULL_VAL;
+	table->entries[index].value = NULL_VAL;
+	table->count--;
+
+	size_t base = index - (index % TABLE_GROUP_WIDTH);
+	if (matchByte(&table->control[base], CTRL_EMPTY) & validMask(table->capacity)) {
+		table->control[index] = CTRL_EMPTY;
+	}
+	else {
+		table->control[index] = CTRL_DELETED;
+		table->tombstones++;
+	}
+
+	return true;
+}
+
+void valueTableRehash(VM* vm, ValueTable* table) {
+	if (table->count == 0) return;
+
+	bool changed = false;
+	for (int i = 0; i <= table->capacity; i++) {
+		if (!CTRL_IS_FULL(table->control[i])) continue;
+
+		ValueEntry* entry = &table->entries[i];
+		uint32_t hash = hashValue(entry->key);
+		if (hash != entry->hash) {
+			entry->hash = hash;
+			changed = true;
+		}
+	}
+
+	if (changed) adjustValueCapacity(vm, table, table->capacity);
 }
\ No newline at end of file
@@ -2,17 +2,45 @@
 #include <core/common.h>
 #include <vm/value.h>
 
+// Control byte states. A full slot stores the low 7 bits of its key's hash (0x00 - 0x7F).
+#define CTRL_EMPTY 0x80
+#define CTRL_DELETED 0xFE
+
+#define CTRL_IS_FULL(ctrl) (((ctrl) & 0x80) == 0)
+
+// Number of control bytes which are probed at once.
+#define TABLE_GROUP_WIDTH 16
+
 typedef struct {
 	ObjString* key;
 	Value value;
 } Entry;
 
 typedef struct {
-	int count;
+	int count; // Live entries.
+	int tombstones;
 	int capacity;
+	uint8_t* control; // One byte per entry, padded to at least TABLE_GROUP_WIDTH.
 	Entry* entries;
+	Obj* owner; // Object holding the table, for the write barrier. NULL for tables owned by the VM.
 } Table;
 
+// Keyed by any value, compared with valuesEqual. The hash is kept so rehashing never recomputes it.
+typedef struct {
+	Value key;
+	Value value;
+	uint32_t hash;
+} ValueEntry;
+
+typedef struct {
+	int count;
+	int tombstones;
+	int capacity;
+	uint8_t* control;
+	ValueEntry* entries;
+	Obj* owner;
+} ValueTable;
+
 typedef struct VM VM;
 
 void initTable(Table* table);
@@ -29,4 +57,19 @@ bool tableDelete(Table* table, ObjString* key);
 
 ObjString* tableFindString(Table* table, const char* chars, size_t length, uint32_t hash);
 
-void tableRemoveWhite(Table* table);
\ No newline at end of file
+void tableCompact(VM* vm, Table* table);
+
+void initValueTable(ValueTable* table);
+
+void freeValueTable(VM* vm, ValueTable* table);
+
+// Keys must be isHashable. New list keys are stored as copies, see hashValue.
+bool valueTableSet(VM* vm, ValueTable* table, Value key, Value value);
+
+bool valueTableGet(ValueTable* table, Value key, Value* value);
+
+bool valueTableDelete(ValueTable* table, Value key);
+
+// Recomputes the hash of each key, and rehashes the table if any changed, as objects other than
+// strings and lists hash by address and the collector may move them.
+void valueTableRehash(VM* vm, ValueTable* table);
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "value.h"
 #include <core/common.h>
 #include <core/memory.h>
+#include <core/number.h>
 #include <compiler/compiler.h>
 #include <vm/vm.h>
 #include <vm/object.h>
@@ -12,20 +13,68 @@ void initValueArray(ValueArray* array) {
 	array->values = NULL;
 	array->capacity = 0;
 	array->count = 0;
+	array->owner = NULL;
+	array->dirty = SIZE_MAX;
+}
+
+// Inline values are copied out, as their storage belongs to the owner.
+static Value* growValues(VM* vm, ValueArray* array, size_t capacity) {
+	if (!hasInlineValues(array)) return GROW_ARRAY(vm, Value, array->values, array->capacity, capacity);
+
+	Value* values = ALLOCATE(vm, Value, capacity);
+	memcpy(values, array->values, sizeof(Value) * array->count);
+	return values;
 }
 
 void writeValueArray(VM* vm, ValueArray* array, Value value) {
 	if (array->capacity < array->count + 1) {
-		size_t oldCap = array->capacity;
-		array->capacity = array->capacity < 8 ? 8 : array->capacity * 2;
-		array->values = GROW_ARRAY(vm, Value, array->values, oldCap, array->capacity);
+		size_t capacity = array->capacity < 8 ? 8 : array->capacity * 2;
+		push(vm, value); // Growing can collect, keep the value rooted.
+		array->values = growValues(vm, array, capacity);
+		array->capacity = capacity;
+		pop(vm);
 	}
 
-	array->values[array->count++] = value;
+	array->values[array->count] = value;
+	writeArrayBarrier(vm, array, array->count, value);
+	array->count++;
+}
+
+// Grows the backing storage to hold at least capacity values without changing the count.
+void reserveValueArray(VM* vm, ValueArray* array, size_t capacity) {
+	if (array->capacity >= capacity) return;
+
+	size_t oldCap = array->capacity;
+	size_t newCap = oldCap < 8 ? 8 : oldCap * 2;
+	if (newCap < capacity) newCap = capacity;
+
+	array->values = growValues(vm, array, newCap);
+	array->capacity = newCap;
+}
+
+void insertValueArray(VM* vm, ValueArray* array, size_t index, Value value) {
+	push(vm, value);
+	reserveValueArray(vm, array, array->count + 1);
+	pop(vm);
+
+	memmove(&array->values[index + 1], &array->values[index], sizeof(Value) * (array->count - index));
+	array->values[index] = value;
+	array->count++;
+	writeArrayBarrier(vm, array, index, value);
+}
+
+Value removeValueArray(ValueArray* array, size_t index) {
+	Value value = array->values[index];
+
+	memmove(&array->values[index], &array->values[index + 1], sizeof(Value) * (array->count - index - 1));
+	array->count--;
+	if (array->dirty != SIZE_MAX && array->dirty > index) array->dirty--;
+
+	return value;
 }
 
 void freeValueArray(VM* vm, ValueArray* array) {
-	FREE_ARRAY(vm, Value, array->values, array->capacity);
+	if (!hasInlineValues(array)) FREE_ARRAY(vm, Value, array->values, array->capacity);
 	initValueArray(array);
 }
 
@@ -56,38 +105,110 @@ bool valuesEqual(Value a, Value b) {
 				return true;
 			}
 			
+			if (AS_OBJ(a)->type == OBJ_STRING && AS_OBJ(b)->type == OBJ_STRING) {
+				ObjString* aString = AS_STRING(a);
+				ObjString* bString = AS_STRING(b);
+
+				// Only views can share contents with a different string.
+				if (aString->interned && bString->interned) return aString == bString;
+
+				return aString->length == bString->length && aString->hash == bString->hash
+					&& memcmp(aString->chars, bString->chars, aString->length) == 0;
+			}
+
 			return AS_OBJ(a) == AS_OBJ(b);
 		default:
 			return false; // Unreachable.
 	}
 }
 
-char* valueToString(VM* vm, Value value) {
-	
-	switch (value.type) {
+// Finalizer from MurmurHash3, spreads every input bit across the result.
+static uint32_t hashBits(uint64_t bits) {
+	bits ^= bits >> 33;
+	bits *= 0xff51afd7ed558ccdULL;
+	bits ^= bits >> 33;
+	bits *= 0xc4ceb9fe1a85ec53ULL;
+	bits ^= bits >> 33;
+	return (uint32_t)bits;
+}
 
-		case VAL_BOOL: {
-			// We use malloc and strcpy here because later in the code it is freed, you can't free a constant string
-			char* buffer = malloc((AS_BOOL(value) ? 4 : 5) * sizeof(char) + 1);
-			strcpy(buffer, value.boolean ? "true" : "false");
-			return buffer;
+// Must agree with valuesEqual, lists hash by content as they compare by content. As lists can change,
+// valueTableSet stores a copy of each new list key: after m[l] = 5; l.append(4), m[[1, 2, 3]] is still
+// found but m[l] is not. Keys must be checked with isHashable first, as a list which contains itself
+// would be hashed forever.
+uint32_t hashValue(Value value) {
+	switch (value.type) {
+		case VAL_BOOL: return AS_BOOL(value) ? 0x9e3779b9u : 0x7f4a7c15u;
+		case VAL_NULL: return 0x2545f491u;
+		case VAL_NUMBER: {
+			double number = AS_NUMBER(value);
+			if (number == 0) number = 0; // -0 == 0
+			uint64_t bits;
+			memcpy(&bits, &number, sizeof(bits));
+			return hashBits(bits);
 		}
+		case VAL_OBJ:
+			switch (OBJ_TYPE(value)) {
+				case OBJ_STRING: return AS_STRING(value)->hash;
+				case OBJ_LIST: {
+					ObjList* list = AS_LIST(value);
+					uint32_t hash = 2166136261u;
+					for (size_t i = 0; i < list->items.count; i++) {
+						hash ^= hashValue(list->items.values[i]);
+						hash *= 16777619;
+					}
+					return hash;
+				}
+				default:
+					return hashBits((uint64_t)(uintptr_t)AS_OBJ(value));
+			}
+	}
+	return 0; // Unreachable
+}
 
-		case VAL_NULL: {
-			char* buffer = malloc(4 * sizeof(char) + 1);
-			strcpy(buffer, "null");
-			return buffer;
-		}
+static bool isHashableAt(Value value, int depth) {
+	if (!IS_LIST(value)) return true;
+	if (depth >= KEY_DEPTH_MAX) return false;
+
+	ValueArray* items = &AS_LIST(value)->items;
+	for (size_t i = 0; i < items->count; i++) {
+		if (!isHashableAt(items->values[i], depth + 1)) return false;
+	}
+	return true;
+}
+
+// Whether value can be used as a map key, that is whether its lists nest no deeper than KEY_DEPTH_MAX.
+bool isHashable(Value value) {
+	return isHashableAt(value, 0);
+}
+
+void writeValue(VM* vm, Buffer* buffer, Value value) {
+	switch (value.type) {
+		case VAL_BOOL:
+			if (AS_BOOL(value)) bufferWrite(buffer, "true", 4);
+			else bufferWrite(buffer, "false", 5);
+			break;
+
+		case VAL_NULL:
+			bufferWrite(buffer, "null", 4);
+			break;
 
 		case VAL_NUMBER: {
-			size_t sizeNeeded = snprintf(NULL, 0, "%g", AS_NUMBER(value)) + 1;
-			char* buffer = malloc(sizeNeeded);
-			sprintf(buffer, "%g", AS_NUMBER(value));
-			return buffer;
-		}
-		case VAL_OBJ: {
-			return objectToString(vm, value);
+			char digits[NUMBER_BUFFER_SIZE];
+			bufferWrite(buffer, digits, formatNumber(AS_NUMBER(value), digits));
+			break;
 		}
+
+		case VAL_OBJ:
+			writeObject(vm, buffer, value);
+			break;
 	}
-	return NULL; // Unreachable
+}
+
+// The returned string is owned by the caller.
+char* valueToString(VM* vm, Value value) {
+	Buffer buffer;
+	initBuffer(&buffer);
+	writeValue(vm, &buffer, value);
+	return bufferTake(&buffer);
 }
@@ -1,5 +1,6 @@
 #pragma once
 #include <core/common.h>
+#include <core/buffer.h>
 
 typedef struct Obj Obj;
 typedef struct ObjString ObjString;
@@ -25,14 +26,31 @@ typedef struct {
 	size_t capacity;
 	size_t count;
 	Value* values;
+	Obj* owner; // Object holding the array, for the write barrier. NULL if it is not part of the heap.
+	size_t dirty; // Values from this index on may be young while the owner is remembered, SIZE_MAX if none.
 } ValueArray;
 
+// Whether the array's values are stored directly after it in its owner, as with ObjList. That storage is
+// never reallocated or freed.
+static inline bool hasInlineValues(ValueArray* array) {
+	return array->values == (Value*)(array + 1);
+}
+
 void initValueArray(ValueArray* array);
 void writeValueArray(VM* vm, ValueArray* array, Value value);
+void reserveValueArray(VM* vm, ValueArray* array, size_t capacity);
+void insertValueArray(VM* vm, ValueArray* array, size_t index, Value value);
+Value removeValueArray(ValueArray* array, size_t index);
 void freeValueArray(VM* vm, ValueArray* array);
 char* valueToString(VM* vm, Value value);
+void writeValue(VM* vm, Buffer* buffer, Value value);
 bool isFalsey(Value value);
 bool valuesEqual(Value a, Value b);
+uint32_t hashValue(Value value);
+bool isHashable(Value value);
+
+// Deepest lists may nest as map keys. A list which contains itself nests without end, so is never hashable.
+#define KEY_DEPTH_MAX 64
 
 #define BOOL_VAL(value)   ((Value){VAL_BOOL, {.boolean = value}})
 #define NULL_VAL           ((Value){VAL_NULL, {.number = 0}})
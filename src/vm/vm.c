@@ -4,15 +4,20 @@
 #include <core/file.h>
 #include <vm/opcodes.h>
 #include <compiler/compiler.h>
+#include <compiler/bytecode.h>
 #include <debug/debugFlags.h>
 #include <debug/disassemble.h>
 #include <vm/object.h>
+#include <vm/snapshot.h>
 #include <natives/globals.h>
 #include <natives/list.h>
+#include <natives/map.h>
+#include <natives/array.h>
 #include <natives/string.h>
 #include <natives/objectNative.h>
 #include <natives/iterator.h>
 #include <natives/exception.h>
+#include <natives/gc.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
@@ -24,6 +29,8 @@ static InterpreterResult import(VM* vm, char* path, ObjString* name, Value* valu
 
 static char* resolveImport(VM* vm, ObjString* path);
 
+static Module* newModule(VM* vm, char* name);
+
 void initVM(VM* vm, char* name) {
 
 	vm->frameSize = 64;
@@ -34,27 +41,55 @@ void initVM(VM* vm, char* name) {
 	vm->stack = malloc(vm->stackSize * sizeof(Value));
 
 	vm->stackTop = vm->stack;
-	vm->objects = NULL;
+	vm->youngCount = 0;
+	vm->youngCapacity = 0;
+	vm->youngObjects = NULL;
 	vm->frameCount = 0;
 	vm->openUpvalues = NULL;
-	vm->grayCount = 0;
-	vm->grayCapacity = 0;
-	vm->grayStack = NULL;
+	initHeap(&vm->heap, gcConfig()->hugePages);
+	initMarker(&vm->marker, vm);
+	vm->markPool = NULL;
+	vm->rememberedCount = 0;
+	vm->rememberedCapacity = 0;
+	vm->remembered = NULL;
+	vm->unsweptPages = NULL;
+	vm->sweepRate = 0;
+	vm->sweepCredit = 0;
 	vm->compiler = NULL;
 	vm->bytesAllocated = 0;
-	vm->nextGC = 1024 * 1024;
+	vm->nextMinorGC = GC_NURSERY_SIZE;
+	vm->nextGCStep = 0;
+	vm->gcPhase = GC_IDLE;
+	initGCStats(&vm->gcStats);
+
+	GCConfig* config = gcConfig();
+	vm->nextGC = config->initialHeap > config->minHeap ? config->initialHeap : config->minHeap;
+	vm->gcGrowFactor = config->growFactor;
+	vm->gcMinHeap = config->minHeap;
+	vm->gcMaxHeap = config->maxHeap;
+	vm->gcPauseTarget = config->pauseTarget;
+	vm->gcMarkThreads = config->markThreads;
+
+	vm->isCollecting = false;
+	vm->isCollectingYoung = false;
+	vm->shouldCompact = false;
 	vm->basePath = NULL;
-	vm->filename = NULL;
-	vm->imports = NULL;
-	vm->importCapacity = 0;
-	vm->importCount = 0;
-	vm->isImport = false;
-	vm->parent = NULL;
-
-	initTable(&vm->globals);
-	initTable(&vm->exports);
+	vm->module = NULL;
+	vm->modules = NULL;
+	vm->moduleCapacity = 0;
+	vm->moduleCount = 0;
+	initTable(&vm->loadedModules);
+	vm->baseFrame = 0;
+	vm->objectClass = NULL;
+	vm->importClass = NULL;
+	vm->iteratorClass = NULL;
+	vm->exceptionClass = NULL;
+
+	initTable(&vm->builtins);
 	initTable(&vm->strings);
 	initTable(&vm->listMethods);
+	initTable(&vm->mapMethods);
+	initTable(&vm->arrayMethods);
 	initTable(&vm->stringMethods);
 
 	ObjClass* objectClass = newClass(vm, copyString(vm, "<object>", 8));
@@ -75,16 +110,65 @@ void initVM(VM* vm, char* name) {
 	defineExceptionMethods(vm, vm->exceptionClass);
 	defineObjectMethods(vm, vm->exceptionClass);
 
-	tableSet(vm, &vm->globals, copyString(vm, "Object", 6), OBJ_VAL(vm->objectClass));
-	tableSet(vm, &vm->globals, copyString(vm, "<object>", 8), OBJ_VAL(vm->objectClass)); // Allows super() in classes with no superclass
-	tableSet(vm, &vm->globals, copyString(vm, "Iterator", 8), OBJ_VAL(vm->iteratorClass));
-	tableSet(vm, &vm->globals, copyString(vm, "Exception", 9), OBJ_VAL(vm->exceptionClass));
-
-	tableSet(vm, &vm->globals, copyString(vm, "_NAME", 5), OBJ_VAL(copyString(vm, name, strlen(name))));
+	tableSet(vm, &vm->builtins, copyString(vm, "Object", 6), OBJ_VAL(vm->objectClass));
+	tableSet(vm, &vm->builtins, copyString(vm, "<object>", 8), OBJ_VAL(vm->objectClass)); // Allows super() in classes with no superclass
+	tableSet(vm, &vm->builtins, copyString(vm, "Iterator", 8), OBJ_VAL(vm->iteratorClass));
+	tableSet(vm, &vm->builtins, copyString(vm, "Exception", 9), OBJ_VAL(vm->exceptionClass));
 
 	defineGlobalVariables(vm);
+	defineGCModule(vm);
 	defineListMethods(vm);
+	defineMapMethods(vm);
+	defineArrayMethods(vm);
 	defineStringMethods(vm);
+
+	vm->module = newModule(vm, name);
+
+	const char* snapshot = startupSnapshot();
+	if (snapshot != NULL && !loadSnapshot(vm, snapshot)) {
+		fprintf(stderr, "Ignoring snapshot '%s', which is missing or was made by another build.\n", snapshot);
+	}
+}
+
+// Creates the globals of a new source file, starting from the builtins. Modules are registered with
+// the VM before anything is put in their tables, so those are always rooted.
+static Module* newModule(VM* vm, char* name) {
+	Module* module = malloc(sizeof(Module));
+	if (module == NULL) exit(1);
+	initTable(&module->globals);
+	initTable(&module->imports);
+	module->exports = NULL;
+	module->filepath = NULL;
+	module->filename = NULL;
+
+	if (vm->moduleCapacity < vm->moduleCount + 1) {
+		size_t oldCapacity = vm->moduleCapacity;
+		vm->moduleCapacity = vm->moduleCapacity < 8 ? 8 : vm->moduleCapacity * 2;
+		vm->modules = GROW_ARRAY(vm, Module*, vm->modules, oldCapacity, vm->moduleCapacity);
+	}
+	vm->modules[vm->moduleCount++] = module;
+
+	module->exports = newInstance(vm, vm->importClass);
+	tableAddAll(vm, &vm->builtins, &module->globals);
+
+	push(vm, OBJ_VAL(copyString(vm, name, strlen(name))));
+	tableSet(vm, &module->globals, copyString(vm, "_NAME", 5), peek(vm, 0));
+	pop(vm);
+
+	return module;
+}
+
+static void freeModule(VM* vm, Module* module) {
+	freeTable(vm, &module->globals);
+	freeTable(vm, &module->imports);
+	free(module->filename);
+	free(module);
+}
+
+// The module of the innermost call, whose globals the running code uses.
+static inline Module* currentModule(VM* vm) {
+	if (vm->frameCount == 0) return vm->module;
+	return vm->frames[vm->frameCount - 1].closure->function->module;
 }
 
 void resetVM(VM* vm) {
@@ -108,20 +192,22 @@ Value peek(VM* vm, size_t distance) {
 }
 
 void runtimeError(VM* vm, const char* format, ...) {
+	flushOutput(); // Keep earlier output ahead of the error.
+
 	va_list args;
 	va_start(args, format);
 	vfprintf(stderr, format, args);
 	va_end(args);
 	fputs("\n", stderr);
 
-	fprintf(stderr, "In File '%s':\n", vm->filename);
+	fprintf(stderr, "In File '%s':\n", currentModule(vm)->filename);
 
 	size_t prevLine = 0;
 	ObjFunction* prevFunction = NULL;
 	size_t count = 0;
 	bool repeating = false;
 
-	for (int i = (int)vm->frameCount - 1; i >= 0; i--) {
+	for (int i = (int)vm->frameCount - 1; i >= (int)vm->baseFrame; i--) {
 		CallFrame* frame = &vm->frames[i];
 		ObjFunction* function = frame->closure->function;
 		// -1 because the IP is sitting on the next instruction to be executed.
@@ -169,37 +255,23 @@ static inline void concat(VM* vm, ObjString* a, ObjString* b) {
 
 static void concatenate(VM* vm, bool firstString, bool secondString) {
 	
-	ObjString* a;
-	ObjString* b;
-	
 	if (firstString && secondString) {
-
-		b = AS_STRING(peek(vm, 0));
-		a = AS_STRING(peek(vm, 1));
-
-		concat(vm, a, b);
-
+		concat(vm, AS_STRING(peek(vm, 1)), AS_STRING(peek(vm, 0)));
+		return;
 	}
-	else if (firstString) {
-		b = AS_STRING(peek(vm, 0));
-		Value aValue = peek(vm, 1);
-
-		char* aChars = valueToString(vm, aValue);
-		a = copyString(vm, aChars, strlen(aChars));
-		free(aChars);
-		concat(vm, a, b);
-	}
-	else {
-		Value bValue = peek(vm, 0);
-		char* bChars = valueToString(vm, bValue);
-		b = copyString(vm, bChars, strlen(bChars));
-		free(bChars);
-		a = AS_STRING(peek(vm, 1));
 
-		concat(vm, a, b);
-	}
-	
+	// Both operands stay on the stack until the result exists, so neither can be collected.
+	Buffer buffer;
+	initBuffer(&buffer);
+	writeValue(vm, &buffer, peek(vm, 1));
+	writeValue(vm, &buffer, peek(vm, 0));
 
+	ObjString* result = copyString(vm, buffer.chars, buffer.length);
+	freeBuffer(&buffer);
+
+	pop(vm);
+	pop(vm);
+	push(vm, OBJ_VAL(result));
 }
 
 static bool call(VM* vm, ObjClosure* closure, size_t argCount) {
@@ -230,21 +302,19 @@ static bool call(VM* vm, ObjClosure* closure, size_t argCount) {
 			for (size_t i = varArgCount; i > needed; i--) {
 				writeValueArray(vm, &varArgs, peek(vm, i - 1));
 			}
-			for (size_t i = varArgCount; i > needed; i--) {
-				pop(vm);
-			}
 		}
 		else {
 			for (size_t i = varArgCount; i >= needed; i--) {
 				writeValueArray(vm, &varArgs, peek(vm, i - 1));
 			}
-			for (size_t i = varArgCount; i >= needed; i--) {
-				pop(vm);
-			}
 		}
 
 		ObjList* list = newList(vm, varArgs);
 
+		for (size_t i = 0; i < varArgs.count; i++) {
+			pop(vm);
+		}
+
 		push(vm, OBJ_VAL(list));
 
 	}
@@ -397,6 +467,7 @@ static void closeUpvalues(VM* vm, Value* last) {
 		ObjUpvalue* upvalue = vm->openUpvalues;
 		upvalue->closed = *upvalue->location;
 		upvalue->location = &upvalue->closed;
+		writeBarrier(vm, &upvalue->obj, upvalue->closed);
 		vm->openUpvalues = upvalue->next;
 
 	}
@@ -438,10 +509,26 @@ static bool invokeFromClass(VM* vm, ObjInstance* instance, ObjClass* klass, ObjS
 	return call(vm, AS_CLOSURE(method), argCount);
 }
 
+// In form: [line] in name
+static ObjString* stackTraceLine(VM* vm, ObjFunction* function, size_t line) {
+	Buffer buffer;
+	initBuffer(&buffer);
+	bufferWriteFormat(&buffer, "[%zu] in ", line);
+	if (function->name == NULL) bufferWriteString(&buffer, "<script>");
+	else bufferWrite(&buffer, function->name->chars, function->name->length);
+
+	ObjString* string = copyString(vm, buffer.chars, buffer.length);
+	freeBuffer(&buffer);
+	return string;
+}
+
 static bool throwGeneral(VM* vm, ObjInstance* throwee) {
 	Table* fields = &throwee->fields;
+	char* filename = currentModule(vm)->filename;
 	push(vm, OBJ_VAL(throwee));
-	tableSet(vm, fields, copyString(vm, "filename", 8), OBJ_VAL(copyString(vm, vm->filename, strlen(vm->filename))));
+	push(vm, OBJ_VAL(copyString(vm, filename, strlen(filename))));
+	tableSet(vm, fields, copyString(vm, "filename", 8), peek(vm, 0));
+	pop(vm);
 
 	ObjFunction* function = vm->frame->closure->function;
 
@@ -453,48 +540,51 @@ static bool throwGeneral(VM* vm, ObjInstance* throwee) {
 
 	ValueArray stackTrace;
 	initValueArray(&stackTrace);
+	ObjList* stackTraceList = newList(vm, stackTrace);
+	push(vm, OBJ_VAL(stackTraceList));
+	tableSet(vm, fields, copyString(vm, "stack", 5), OBJ_VAL(stackTraceList));
+	pop(vm);
 
+	// The throwee stays on top of the stack while the trace is built, which keeps it rooted.
 	while (!vm->frame->isTry) {
-		Value result = pop(vm);
-
-		closeUpvalues(vm, vm->frame->slots);
-
 		function = vm->frame->closure->function;
 
 		instruction = vm->frame->ip - function->chunk.code - 1;
 
 		line = getLine(&function->chunk.table, instruction);
 
-		// In form:
-		// [%d] in %s <- line, function name
-		size_t lineNumberLength = snprintf(NULL, 0, "%zu", line);
-		size_t lineLength = 1 + lineNumberLength + 1 + 4 + (function->name == NULL ? 8 : function->name->length);
-		char* str = malloc(lineLength + 1);
-		sprintf(str, "[%zu] in %s", line, function->name == NULL ? "<script>" : function->name->chars);
+		writeValueArray(vm, &stackTraceList->items, OBJ_VAL(stackTraceLine(vm, function, line)));
+
+		Value result = peek(vm, 0);
 
-		writeValueArray(vm, &stackTrace, OBJ_VAL(takeString(vm, str, lineLength)));
+		closeUpvalues(vm, vm->frame->slots);
 
+		// An import reports its uncaught exceptions itself, rather than unwinding into its importer.
 		vm->frameCount--;
-		if (vm->frameCount == 0) {
-			pop(vm);
+		if (vm->frameCount == vm->baseFrame) {
+			Buffer report;
+			initBuffer(&report);
+
+			Value name;
+			if (tableGet(fields, copyString(vm, "name", 4), &name)) writeValue(vm, &report, name);
+			else bufferWriteString(&report, "Exception");
+			bufferWrite(&report, ": ", 2);
 
 			Value value;
-			char* valueString = "\0";
-			if (tableGet(fields, copyString(vm, "value", 5), &value)) {
-				valueString = valueToString(vm, value);
-			}
+			if (tableGet(fields, copyString(vm, "value", 5), &value)) writeValue(vm, &report, value);
+			bufferWriteFormat(&report, "\nIn file %s:\n", filename);
 
-			Value name;
-			char* nameString = NULL;
-			if (tableGet(fields, copyString(vm, "name", 4), &name)) {
-				nameString = valueToString(vm, name);
+			for (size_t i = 0; i < stackTraceList->items.count; i++) {
+				writeValue(vm, &report, stackTraceList->items.values[i]);
+				bufferWriteChar(&report, '\n');
 			}
 
-			fprintf(stderr, "%s: %s\nIn file %s:\n", nameString == NULL ? "Exception" : nameString, valueString, vm->filename);
+			flushOutput();
+			fwrite(report.chars, 1, report.length, stderr);
+			freeBuffer(&report);
 
-			for (size_t i = 0; i < stackTrace.count; i++) {
-				fprintf(stderr, "%s\n", AS_CSTRING(stackTrace.values[i]));
-			}
+			pop(vm);
+			pop(vm);
 
 			return false;
 		}
@@ -512,19 +602,7 @@ static bool throwGeneral(VM* vm, ObjInstance* throwee) {
 
 	line = getLine(&function->chunk.table, instruction);
 
-	// In form:
-	// [%d] in %s <- line, function name
-	size_t lineNumberLength = snprintf(NULL, 0, "%zu", line);
-	size_t lineLength = 1 + lineNumberLength + 1 + 4 + (function->name == NULL ? 8 : function->name->length);
-	char* str = malloc(lineLength + 1);
-	sprintf(str, "[%zu] in %s", line, function->name == NULL ? "<script>" : function->name->chars);
-
-	writeValueArray(vm, &stackTrace, OBJ_VAL(takeString(vm, str, lineLength)));
-
-
-	ObjList* stackTraceList = newList(vm, stackTrace);
-
-	tableSet(vm, fields, copyString(vm, "stack", 5), OBJ_VAL(stackTraceList));
+	writeValueArray(vm, &stackTraceList->items, OBJ_VAL(stackTraceLine(vm, function, line)));
 
 	vm->frame->isTry = false;
 	vm->frame->ip = vm->frame->catchJump;
@@ -536,18 +614,27 @@ bool throwException(VM* vm, char* name, char* reason, ...) {
 
 	va_list args;
 	va_start(args, reason);
-	int length = vsnprintf(NULL, 0, reason, args);
+	va_list sizeArgs;
+	va_copy(sizeArgs, args);
+	int length = vsnprintf(NULL, 0, reason, sizeArgs);
+	va_end(sizeArgs);
 	char* value = malloc(length + 1);
 	vsprintf(value, reason, args);
 	va_end(args);
 
 	ObjInstance* inst = newInstance(vm, vm->exceptionClass);
+	push(vm, OBJ_VAL(inst));
 
 	Table* fields = &inst->fields;
 
-	tableSet(vm, fields, copyString(vm, "value", 5), OBJ_VAL(takeString(vm, value, strlen(value))));
-	tableSet(vm, fields, copyString(vm, "name", 4), OBJ_VAL(copyString(vm, name, strlen(name))));
+	push(vm, OBJ_VAL(takeString(vm, value, strlen(value))));
+	tableSet(vm, fields, copyString(vm, "value", 5), peek(vm, 0));
+	pop(vm);
+	push(vm, OBJ_VAL(copyString(vm, name, strlen(name))));
+	tableSet(vm, fields, copyString(vm, "name", 4), peek(vm, 0));
+	pop(vm);
 
+	pop(vm);
 	return throwGeneral(vm, inst);
 }
 
@@ -577,6 +664,32 @@ bool invoke(VM* vm, ObjString* name, int argCount) {
 		pop(vm);
 		return throwException(vm, "UndefinedPropertyException", "Undefined list method.");
 	}
+	else if (IS_MAP(receiver)) {
+		Value value;
+		if (tableGet(&vm->mapMethods, name, &value)) {
+			vm->stackTop[-argCount - 1] = receiver;
+			ObjNative* native = AS_NATIVE_OBJ(value);
+			native->isBound = true;
+			native->bound = receiver;
+			return callValue(vm, OBJ_VAL(native), argCount);
+		}
+		pop(vm);
+		pop(vm);
+		return throwException(vm, "UndefinedPropertyException", "Undefined map method.");
+	}
+	else if (IS_ARRAY(receiver)) {
+		Value value;
+		if (tableGet(&vm->arrayMethods, name, &value)) {
+			vm->stackTop[-argCount - 1] = receiver;
+			ObjNative* native = AS_NATIVE_OBJ(value);
+			native->isBound = true;
+			native->bound = receiver;
+			return callValue(vm, OBJ_VAL(native), argCount);
+		}
+		pop(vm);
+		pop(vm);
+		return throwException(vm, "UndefinedPropertyException", "Undefined array method.");
+	}
 	else if (IS_STRING(receiver)) {
 		Value value;
 		if (tableGet(&vm->stringMethods, name, &value)) {
@@ -606,6 +719,7 @@ InterpreterResult execute(VM* vm, Chunk* chunk) {
 #define READ_SHORT() (vm->frame->ip += 2, (uint16_t)((vm->frame->ip[-2] << 8) | vm->frame->ip[-1]))
 #define READ_CONSTANT() (vm->frame->closure->function->chunk.constants.values[READ_BYTE()])
 #define READ_STRING() (AS_STRING(READ_CONSTANT()))
+#define MODULE() (vm->frame->closure->function->module)
 	
 #define BINARY_OP(vm, valueType, op) \
 	do { \
@@ -806,18 +920,20 @@ InterpreterResult execute(VM* vm, Chunk* chunk) {
 
 			case OP_ADD: {
 				if (IS_LIST(peek(vm, 1))) {
-					Value toAppend = pop(vm);
-					ObjList* list = AS_LIST(pop(vm));
+					Value toAppend = peek(vm, 0);
+					ObjList* list = AS_LIST(peek(vm, 1));
 
 					ValueArray array;
 					initValueArray(&array);
-					for (size_t i = 0; i < list->items.count; i++) {
-						writeValueArray(vm, &array, list->items.values[i]);
-					}
-					writeValueArray(vm, &array, toAppend);
+					reserveValueArray(vm, &array, list->items.count + 1);
+					if (list->items.count > 0) memcpy(array.values, list->items.values, sizeof(Value) * list->items.count);
+					array.values[list->items.count] = toAppend;
+					array.count = list->items.count + 1;
 
 					ObjList* nList = newList(vm, array);
 
+					pop(vm);
+					pop(vm);
 					push(vm, OBJ_VAL(nList));
 					break;
 				}
@@ -896,14 +1012,32 @@ InterpreterResult execute(VM* vm, Chunk* chunk) {
 					push(vm, BOOL_VAL(false));
 				exitLoop:;
 				}
+				else if (IS_MAP(b)) {
+					if (!isHashable(a)) {
+						if (!throwException(vm, "TypeException", "Map keys cannot be lists which contain themselves or nest over %d deep.", KEY_DEPTH_MAX)) return STATUS_RUNTIME_ERR;
+						break;
+					}
+					Value value;
+					push(vm, BOOL_VAL(valueTableGet(&AS_MAP(b)->items, a, &value)));
+				}
+				else if (IS_ARRAY(b)) {
+					ObjArray* array = AS_ARRAY(b);
+					bool found = false;
+					if (IS_NUMBER(a)) {
+						for (size_t i = 0; i < array->count && !found; i++) {
+							found = arrayGet(array, i) == AS_NUMBER(a);
+						}
+					}
+					push(vm, BOOL_VAL(found));
+				}
 				else if (IS_STRING(b)) {
 					if (!IS_STRING(a)) {
 						if (!throwException(vm, "InvalidOperationException", "Can only test for strings within strings.")) return STATUS_RUNTIME_ERR;
 						break;
 					}
-					char* string = AS_CSTRING(b);
-					char* needle = AS_CSTRING(a);
-					push(vm, BOOL_VAL(strstr(string, needle) != NULL));
+					ObjString* string = AS_STRING(b);
+					ObjString* needle = AS_STRING(a);
+					push(vm, BOOL_VAL(findSubstring(string->chars, string->length, needle->chars, needle->length) != STRING_NOT_FOUND));
 				}
 				else {
 					if (!throwException(vm, "InvalidOperationException", "Right hand operator must be iterable.")) return STATUS_RUNTIME_ERR;
@@ -995,15 +1129,15 @@ InterpreterResult execute(VM* vm, Chunk* chunk) {
 
 			case OP_DEFINE_GLOBAL: {
 				ObjString* name = READ_STRING();
-				tableSet(vm, &vm->globals, name, peek(vm, 0));
+				tableSet(vm, &MODULE()->globals, name, peek(vm, 0));
 				pop(vm);
 				break;
 			}
 
 			case OP_SET_GLOBAL: {
 				ObjString* name = READ_STRING();
-				if (tableSet(vm, &vm->globals, name, peek(vm, 0))) {
-					tableDelete(&vm->globals, name);
+				if (tableSet(vm, &MODULE()->globals, name, peek(vm, 0))) {
+					tableDelete(&MODULE()->globals, name);
 					pop(vm);
 					if (!throwException(vm, "UndefinedVariableException", "Undefined variable '%s'.", name->chars)) return STATUS_RUNTIME_ERR;
 					break;
@@ -1014,7 +1148,7 @@ InterpreterResult execute(VM* vm, Chunk* chunk) {
 			case OP_GET_GLOBAL: {
 				ObjString* name = READ_STRING();
 				Value value;
-				if (!tableGet(&vm->globals, name, &value)) {
+				if (!tableGet(&MODULE()->globals, name, &value)) {
 					if (!throwException(vm, "UndefinedVariableException", "Undefined variable '%s'.", name->chars)) return STATUS_RUNTIME_ERR;
 					break;
 				}
@@ -1055,6 +1189,7 @@ InterpreterResult execute(VM* vm, Chunk* chunk) {
 			case OP_LOOP: {
 				uint16_t offset = READ_SHORT();
 				vm->frame->ip -= offset;
+				if (vm->shouldCompact) compactHeap(vm);
 				break;
 			}
 
@@ -1081,6 +1216,7 @@ InterpreterResult execute(VM* vm, Chunk* chunk) {
 					else {
 						closure->upvalues[i] = vm->frame->closure->upvalues[index];
 					}
+					writeBarrier(vm, &closure->obj, OBJ_VAL(closure->upvalues[i]));
 				}
 				break;
 			}
@@ -1104,7 +1240,9 @@ InterpreterResult execute(VM* vm, Chunk* chunk) {
 
 			case OP_SET_UPVALUE: {
 				uint8_t slot = READ_BYTE();
-				*vm->frame->closure->upvalues[slot]->location = peek(vm, 0);
+				ObjUpvalue* upvalue = vm->frame->closure->upvalues[slot];
+				*upvalue->location = peek(vm, 0);
+				writeBarrier(vm, &upvalue->obj, peek(vm, 0));
 				break;
 			}
 
@@ -1193,6 +1331,34 @@ InterpreterResult execute(VM* vm, Chunk* chunk) {
 					push(vm, OBJ_VAL(native));
 					break;
 				}
+				else if (IS_MAP(peek(vm, 0))) {
+					Value value;
+					if (!tableGet(&vm->mapMethods, name, &value)) {
+						pop(vm);
+						if (!throwException(vm, "UndefinedPropertyException", "Undefined map method '%s'.", name->chars)) return STATUS_RUNTIME_ERR;
+						break;
+					}
+					ObjNative* native = AS_NATIVE_OBJ(value);
+					native->bound = peek(vm, 0);
+					native->isBound = true;
+					pop(vm);
+					push(vm, OBJ_VAL(native));
+					break;
+				}
+				else if (IS_ARRAY(peek(vm, 0))) {
+					Value value;
+					if (!tableGet(&vm->arrayMethods, name, &value)) {
+						pop(vm);
+						if (!throwException(vm, "UndefinedPropertyException", "Undefined array method '%s'.", name->chars)) return STATUS_RUNTIME_ERR;
+						break;
+					}
+					ObjNative* native = AS_NATIVE_OBJ(value);
+					native->bound = peek(vm, 0);
+					native->isBound = true;
+					pop(vm);
+					push(vm, OBJ_VAL(native));
+					break;
+				}
 				else if (IS_STRING(peek(vm, 0))) {
 					Value value;
 					tableGet(&vm->stringMethods, name, &value);
@@ -1228,16 +1394,17 @@ InterpreterResult execute(VM* vm, Chunk* chunk) {
 			case OP_LIST: {
 				uint8_t itemCount = READ_BYTE();
 
+				// The items stay on the stack until the list holds them, as allocating it can collect. Short
+				// lists fit in the list's own storage, so need no further allocation.
 				ValueArray items;
 				initValueArray(&items);
+				ObjList* list = newList(vm, items);
+				push(vm, OBJ_VAL(list));
+				reserveValueArray(vm, &list->items, itemCount);
 				for (size_t i = 0; i < itemCount; i++) {
-					writeValueArray(vm, &items, peek(vm, itemCount - i - 1));
-				}
-				for (size_t i = 0; i < itemCount; i++) {
-					pop(vm);
+					writeValueArray(vm, &list->items, peek(vm, itemCount - i));
 				}
-
-				ObjList* list = newList(vm, items);
+				vm->stackTop -= itemCount + 1;
 				push(vm, OBJ_VAL(list));
 
 				break;
@@ -1262,7 +1429,8 @@ InterpreterResult execute(VM* vm, Chunk* chunk) {
 						break;
 					}
 
-					ObjString* name = AS_STRING(pop(vm));
+					ObjString* name = internString(vm, AS_STRING(peek(vm, 0)));
+					pop(vm);
 
 					Value value;
 					if (tableGet(&instance->fields, name, &value)) {
@@ -1279,6 +1447,45 @@ InterpreterResult execute(VM* vm, Chunk* chunk) {
 
 				}
 
+				if (IS_MAP(peek(vm, 1))) {
+					if (!isHashable(peek(vm, 0))) {
+						if (!throwException(vm, "TypeException", "Map keys cannot be lists which contain themselves or nest over %d deep.", KEY_DEPTH_MAX)) return STATUS_RUNTIME_ERR;
+						break;
+					}
+
+					Value value;
+					if (!valueTableGet(&AS_MAP(peek(vm, 1))->items, peek(vm, 0), &value)) {
+						value = NULL_VAL;
+					}
+					pop(vm);
+					pop(vm);
+					push(vm, value);
+					break;
+				}
+
+				if (IS_ARRAY(peek(vm, 1))) {
+					ObjArray* array = AS_ARRAY(peek(vm, 1));
+
+					if (!IS_NUMBER(peek(vm, 0)) || ceil(AS_NUMBER(peek(vm, 0))) != AS_NUMBER(peek(vm, 0))) {
+						if (!throwException(vm, "InvalidIndexException", "Can only index an array using an integer.")) return STATUS_RUNTIME_ERR;
+						break;
+					}
+
+					double dindex = AS_NUMBER(peek(vm, 0));
+					if (dindex < 0) dindex += (double)array->count;
+
+					if (dindex < 0 || dindex >= (double)array->count) {
+						if (!throwException(vm, "IndexOutOfBoundsException", "Index is out of bounds for array length.")) return STATUS_RUNTIME_ERR;
+						break;
+					}
+
+					Value v = NUMBER_VAL(arrayGet(array, (size_t)dindex));
+					pop(vm);
+					pop(vm);
+					push(vm, v);
+					break;
+				}
+
 				if (IS_STRING(peek(vm, 1))) {
 					ObjString* string = AS_STRING(peek(vm, 1));
 
@@ -1382,7 +1589,8 @@ InterpreterResult execute(VM* vm, Chunk* chunk) {
 						break;
 					}
 
-					ObjString* name = AS_STRING(peek(vm, 1));
+					ObjString* name = internString(vm, AS_STRING(peek(vm, 1)));
+					vm->stackTop[-2] = OBJ_VAL(name);
 
 					Value value = peek(vm, 0);
 					tableSet(vm, &instance->fields, name, value);
@@ -1395,6 +1603,50 @@ InterpreterResult execute(VM* vm, Chunk* chunk) {
 				}
 
 
+				if (IS_MAP(peek(vm, 2))) {
+					if (!isHashable(peek(vm, 1))) {
+						if (!throwException(vm, "TypeException", "Map keys cannot be lists which contain themselves or nest over %d deep.", KEY_DEPTH_MAX)) return STATUS_RUNTIME_ERR;
+						break;
+					}
+
+					if (IS_STRING_VIEW(peek(vm, 1))) vm->stackTop[-2] = OBJ_VAL(internString(vm, AS_STRING(peek(vm, 1))));
+					valueTableSet(vm, &AS_MAP(peek(vm, 2))->items, peek(vm, 1), peek(vm, 0));
+					Value value = pop(vm);
+					pop(vm);
+					pop(vm);
+					push(vm, value);
+					break;
+				}
+
+				if (IS_ARRAY(peek(vm, 2))) {
+					ObjArray* array = AS_ARRAY(peek(vm, 2));
+
+					if (!IS_NUMBER(peek(vm, 1)) || ceil(AS_NUMBER(peek(vm, 1))) != AS_NUMBER(peek(vm, 1))) {
+						if (!throwException(vm, "InvalidIndexException", "Can only index an array using an integer.")) return STATUS_RUNTIME_ERR;
+						break;
+					}
+
+					if (!IS_NUMBER(peek(vm, 0))) {
+						if (!throwException(vm, "TypeException", "Can only store numbers in an array.")) return STATUS_RUNTIME_ERR;
+						break;
+					}
+
+					double dindex = AS_NUMBER(peek(vm, 1));
+					if (dindex < 0) dindex += (double)array->count;
+
+					if (dindex < 0 || dindex >= (double)array->count) {
+						if (!throwException(vm, "IndexOutOfBoundsException", "Index is out of bounds for array length.")) return STATUS_RUNTIME_ERR;
+						break;
+					}
+
+					arraySet(array, (size_t)dindex, AS_NUMBER(peek(vm, 0)));
+					Value v = pop(vm);
+					pop(vm);
+					pop(vm);
+					push(vm, v);
+					break;
+				}
+
 				if (!IS_LIST(peek(vm, 2))) {
 					if (!throwException(vm, "InvalidOperationException", "Can only index into lists.")) return STATUS_RUNTIME_ERR;
 					break;
@@ -1420,6 +1672,7 @@ InterpreterResult execute(VM* vm, Chunk* chunk) {
 
 					Value v = pop(vm);
 					list->items.values[list->items.count - absIndex] = v;
+					writeArrayBarrier(vm, &list->items, list->items.count - absIndex, v);
 					pop(vm);
 					pop(vm);
 					push(vm, v);
@@ -1435,6 +1688,7 @@ InterpreterResult execute(VM* vm, Chunk* chunk) {
 
 				Value v = pop(vm);
 				list->items.values[uIndex] = v;
+				writeArrayBarrier(vm, &list->items, uIndex, v);
 				pop(vm);
 				pop(vm);
 				push(vm, v);
@@ -1445,7 +1699,7 @@ InterpreterResult execute(VM* vm, Chunk* chunk) {
 				Value toExport = pop(vm);
 				ObjString* string = READ_STRING();
 
-				tableSet(vm, &vm->exports, string, toExport);
+				tableSet(vm, &MODULE()->exports->fields, string, toExport);
 				break;
 			}
 
@@ -1453,24 +1707,28 @@ InterpreterResult execute(VM* vm, Chunk* chunk) {
 				ObjString* path = READ_STRING();
 				ObjString* name = READ_STRING();
 
-				char* resolvedFile = resolveImport(vm, path);
+				// Each file resolves an import path only once, so imports run repeatedly cost a lookup.
+				Value object;
+				if (!tableGet(&MODULE()->imports, path, &object)) {
+					char* resolvedFile = resolveImport(vm, path);
 
-				if (resolvedFile == NULL) {
-					if (!throwException(vm, "InvalidImportException", "Could not find import '%s'.", path->chars)) return STATUS_RUNTIME_ERR;
-					break;
-				}
+					if (resolvedFile == NULL) {
+						if (!throwException(vm, "InvalidImportException", "Could not find import '%s'.", path->chars)) return STATUS_RUNTIME_ERR;
+						break;
+					}
 
-				Value object;
-				InterpreterResult result = import(vm, resolvedFile, name, &object);
+					InterpreterResult result = import(vm, resolvedFile, name, &object);
+					free(resolvedFile);
 
-				if (result != STATUS_OK) {
-					if (!throwException(vm, "InvalidImportException", "An Error occured whilst importing '%s'", path->chars)) return STATUS_RUNTIME_ERR;
-					break;
+					if (result != STATUS_OK) {
+						if (!throwException(vm, "InvalidImportException", "An Error occured whilst importing '%s'", path->chars)) return STATUS_RUNTIME_ERR;
+						break;
+					}
+
+					tableSet(vm, &MODULE()->imports, path, object);
 				}
 
 				push(vm, object);
-				free(resolvedFile);
-
 				break;
 			}
 
@@ -1478,31 +1736,32 @@ InterpreterResult execute(VM* vm, Chunk* chunk) {
 				ObjString* path = READ_STRING();
 				ObjString* name = READ_STRING();
 
-				char* resolvedFile = resolveImport(vm, path);
+				Value object;
+				if (!tableGet(&MODULE()->imports, path, &object)) {
+					char* resolvedFile = resolveImport(vm, path);
 
-				if (resolvedFile == NULL) {
-					if (!throwException(vm, "InvalidImportException", "Could not find import '%s'.", path->chars)) return STATUS_RUNTIME_ERR;
-					break;
-				}
+					if (resolvedFile == NULL) {
+						if (!throwException(vm, "InvalidImportException", "Could not find import '%s'.", path->chars)) return STATUS_RUNTIME_ERR;
+						break;
+					}
 
-				Value object;
-				InterpreterResult result = import(vm, resolvedFile, name, &object);
+					InterpreterResult result = import(vm, resolvedFile, name, &object);
+					free(resolvedFile);
 
-				if (result != STATUS_OK) {
-					if (!throwException(vm, "InvalidImportException", "An Error occured whilst importing '%s'", path->chars)) return STATUS_RUNTIME_ERR;
-					break;
+					if (result != STATUS_OK) {
+						if (!throwException(vm, "InvalidImportException", "An Error occured whilst importing '%s'", path->chars)) return STATUS_RUNTIME_ERR;
+						break;
+					}
+
+					tableSet(vm, &MODULE()->imports, path, object);
 				}
 
 				ObjInstance* obj = AS_INSTANCE(object);
 
 				for (int i = 0; i <= obj->fields.capacity; i++) {
 					Entry* entry = &obj->fields.entries[i];
-					if (entry->key != NULL) {
-						// Copying the string due to interning making them different
-						tableSet(vm, &vm->globals, copyString(vm, entry->key->chars, entry->key->length), entry->value);
-					}
+					if (entry->key != NULL) tableSet(vm, &MODULE()->globals, entry->key, entry->value);
 				}
-				free(resolvedFile);
 
 				break;
 			}
@@ -1531,6 +1790,8 @@ InterpreterResult execute(VM* vm, Chunk* chunk) {
 						case OBJ_INSTANCE: stringRep = "object"; break;
 						case OBJ_STRING: stringRep = "string"; break;
 						case OBJ_LIST: stringRep = "list"; break;
+						case OBJ_MAP: stringRep = "map"; break;
+						case OBJ_ARRAY: stringRep = "array"; break;
 					}
 				}
 
@@ -1575,15 +1836,18 @@ InterpreterResult execute(VM* vm, Chunk* chunk) {
 			}
 
 			case OP_THROW: {
-				Value throwee = pop(vm);
+				Value throwee = peek(vm, 0);
 
 				if(!IS_INSTANCE(throwee)) {
 					ObjInstance* inst = newInstance(vm, vm->exceptionClass);
+					push(vm, OBJ_VAL(inst));
 
 					tableSet(vm, &inst->fields, copyString(vm, "value", 5), throwee);
 
+					pop(vm);
 					throwee = OBJ_VAL(inst);
 				}
+				pop(vm);
 				if (!throwGeneral(vm, AS_INSTANCE(throwee))) return STATUS_RUNTIME_ERR;
 
 				break;
@@ -1609,7 +1873,7 @@ InterpreterResult execute(VM* vm, Chunk* chunk) {
 				closeUpvalues(vm, vm->frame->slots);
 
 				vm->frameCount--;
-				if (vm->frameCount == 0) {
+				if (vm->frameCount == vm->baseFrame) {
 					pop(vm);
 					return STATUS_OK;
 				}
@@ -1619,6 +1883,7 @@ InterpreterResult execute(VM* vm, Chunk* chunk) {
 
 				vm->frame = &vm->frames[vm->frameCount - 1];
 
+				if (vm->shouldCompact) compactHeap(vm);
 				break;
 			}
 		}
@@ -1626,23 +1891,14 @@ InterpreterResult execute(VM* vm, Chunk* chunk) {
 	}
 
 	return STATUS_OK;
+#undef MODULE
 #undef READ_STRING
 #undef READ_CONSTANT
 #undef READ_SHORT
 }
 
-InterpreterResult interpret(char* basePath, char* filename, const char* source) {
-	VM vm;
-	initVM(&vm, "main");
-
-	InterpreterResult result = interpretVM(&vm, basePath, filename, source);
-
-	freeVM(&vm);
-
-	return result;
-}
-
-InterpreterResult interpretVM(VM* vm, char* basePath, char* filename, const char* source) {
+// Only source read from a file is cached, the REPL's lines are compiled each time.
+static InterpreterResult runSource(VM* vm, char* basePath, char* filename, const char* source, bool isFile) {
 
 	Chunk chunk;
 	initChunk(&chunk);
@@ -1650,11 +1906,33 @@ InterpreterResult interpretVM(VM* vm, char* basePath, char* filename, const char
 	ObjString* base = copyString(vm, basePath, strlen(basePath));
 
 	vm->basePath = base;
-	vm->filepath = base;
-
-	vm->filename = filename;
+	vm->module->filepath = base;
+
+	if (vm->module->filename != filename) free(vm->module->filename);
+	vm->module->filename = filename;
+
+	ObjFunction* function;
+	if (isFile) {
+		size_t baseLength = strlen(basePath);
+		size_t nameLength = strlen(filename);
+		char* path = malloc(baseLength + nameLength + 1);
+		memcpy(path, basePath, baseLength);
+		strcpy(path + baseLength, filename);
+
+		// Registered like an import, so a file importing the script back gets its exports rather than running it again.
+		char* canonical = canonicalPath(path);
+		if (canonical != NULL) {
+			push(vm, OBJ_VAL(takeString(vm, canonical, strlen(canonical))));
+			tableSet(vm, &vm->loadedModules, AS_STRING(peek(vm, 0)), OBJ_VAL(vm->module->exports));
+			pop(vm);
+		}
 
-	ObjFunction* function = compile(vm, source, &chunk);
+		function = compileFile(vm, path, source, strlen(source));
+		free(path);
+	}
+	else {
+		function = compile(vm, source, &chunk);
+	}
 	if (function == NULL) return STATUS_COMPILE_ERR;
 
 	vm->compiler = NULL;
@@ -1669,16 +1947,32 @@ InterpreterResult interpretVM(VM* vm, char* basePath, char* filename, const char
 	return execute(vm, &vm->frames[vm->frameCount - 1].closure->function->chunk);
 }
 
+InterpreterResult interpret(char* basePath, char* filename, const char* source) {
+	VM vm;
+	initVM(&vm, "main");
+
+	InterpreterResult result = runSource(&vm, basePath, filename, source, true);
+
+	freeVM(&vm);
+
+	return result;
+}
+
+InterpreterResult interpretVM(VM* vm, char* basePath, char* filename, const char* source) {
+	return runSource(vm, basePath, filename, source, false);
+}
+
 static char* resolveImport(VM* vm, ObjString* path) {
 
 	char* extension = ".fox";
+	ObjString* filepath = currentModule(vm)->filepath;
 
-	char* string = malloc(path->length + vm->filepath->length + 4 /*.fox*/ + 1);
+	char* string = malloc(path->length + filepath->length + 4 /*.fox*/ + 1);
 
-	memcpy(string, vm->filepath->chars, vm->filepath->length);
-	memcpy(string + vm->filepath->length, path->chars, path->length);
-	memcpy(string + vm->filepath->length + path->length, extension, 4);
-	string[path->length + vm->filepath->length + 4] = '\0';
+	memcpy(string, filepath->chars, filepath->length);
+	memcpy(string + filepath->length, path->chars, path->length);
+	memcpy(string + filepath->length + path->length, extension, 4);
+	string[path->length + filepath->length + 4] = '\0';
 
 	if (_access(string, 0) == 0) return string;
 
@@ -1725,20 +2019,36 @@ static char* resolveImport(VM* vm, ObjString* path) {
 	return NULL;
 }
 
-InterpreterResult import(VM* importingVm, char* path, ObjString* name, Value* value) {
-	VM* vm = malloc(sizeof(VM));
-	initVM(vm, "module");
+// Runs the file at path as a new module of vm, on top of the importer's frames, and returns the object
+// holding its exports. The importer's frames are hidden from the module while it runs, so an error in
+// it is reported from the module and the import fails, rather than unwinding into the importer.
+// A file is only run once, later imports of it, by any path, share the exports of the first. Those
+// are registered before the module runs, so an import cycle sees the exports made so far.
+InterpreterResult import(VM* vm, char* path, ObjString* name, Value* value) {
+	char* canonical = canonicalPath(path);
+	if (canonical == NULL) {
+		fprintf(stderr, "Could not open file \"%s\".\n", path);
+		return STATUS_RUNTIME_ERR;
+	}
 
-	vm->isImport = true;
-	vm->parent = importingVm;
+	ObjString* key = takeString(vm, canonical, strlen(canonical));
+	if (tableGet(&vm->loadedModules, key, value)) return STATUS_OK;
 
-	Chunk chunk;
-	initChunk(&chunk);
+	File file = readFile(path);
+	if (file.isError) {
+		fprintf(stderr, "%s\n", file.contents);
+		free(file.contents);
+		return STATUS_RUNTIME_ERR;
+	}
+
+	push(vm, OBJ_VAL(key));
 
-	vm->basePath = importingVm->basePath;
-	vm->filename = malloc(name->length + 5);
-	strcpy(vm->filename, name->chars);
-	strcpy(vm->filename + name->length, ".fox");
+	Module* importer = vm->module;
+	Module* module = newModule(vm, "module");
+
+	module->filename = malloc(name->length + 5);
+	strcpy(module->filename, name->chars);
+	strcpy(module->filename + name->length, ".fox");
 
 	size_t filepathIndex = (fromLastInstance(path, "/") - path) + 1;
 
@@ -1746,70 +2056,69 @@ InterpreterResult import(VM* importingVm, char* path, ObjString* name, Value* va
 	memcpy(filepath, path, filepathIndex);
 	filepath[filepathIndex] = '\0';
 
-	vm->filepath = takeString(vm, filepath, filepathIndex);
+	module->filepath = takeString(vm, filepath, filepathIndex);
 
-	File file = readFile(path);
-	char* source = file.contents;
-	if (file.isError) { 
-		fprintf(stderr, "%s\n", file.contents);
-		free(file.contents);
-		return STATUS_RUNTIME_ERR; 
+	vm->module = module;
+	ObjFunction* function = compileFile(vm, path, file.contents, file.length);
+	free(file.contents);
+	vm->module = importer;
+
+	if (function == NULL) {
+		pop(vm);
+		return STATUS_COMPILE_ERR;
 	}
 
-	ObjFunction* function = compile(vm, source, &chunk);
-	if (function == NULL) return STATUS_COMPILE_ERR;
+	*value = OBJ_VAL(module->exports);
+	tableSet(vm, &vm->loadedModules, key, *value);
+	pop(vm);
 
-	vm->compiler = NULL;
+	size_t baseFrame = vm->baseFrame;
+	size_t stackCount = vm->stackTop - vm->stack;
+	vm->baseFrame = vm->frameCount;
 
 	push(vm, OBJ_VAL(function));
 
 	ObjClosure* closure = newClosure(vm, function);
 	pop(vm);
 	push(vm, OBJ_VAL(closure));
-	callValue(vm, OBJ_VAL(closure), 0);
 
-	InterpreterResult result = execute(vm, &vm->frames[vm->frameCount - 1].closure->function->chunk);
+	InterpreterResult result = STATUS_RUNTIME_ERR;
+	if (callValue(vm, OBJ_VAL(closure), 0)) result = execute(vm, &closure->function->chunk);
 
-	ObjInstance* obj = newInstance(importingVm, importingVm->importClass);
-
-	for (int i = 0; i <= vm->exports.capacity; i++) {
-		Entry* entry = &vm->exports.entries[i];
-		if (entry->key != NULL) {
-			// Copying the string due to interning making them different
-			tableSet(importingVm, &obj->fields, copyString(importingVm, entry->key->chars, entry->key->length), entry->value);
-		}
-	}
-
-	*value = OBJ_VAL(obj);
-
-	// Cleans up memory which can no longer be accessed.
-	collectGarbage(vm);
-
-	if (importingVm->importCapacity < importingVm->importCount + 1) {
-		size_t oldCapacity = importingVm->importCapacity;
-		importingVm->importCapacity = importingVm->importCapacity < 8 ? 8 : importingVm->importCapacity * 2;
-		importingVm->imports = GROW_ARRAY(importingVm, VM*, importingVm->imports, oldCapacity, importingVm->importCapacity);
-	}
+	// An error leaves the module's frames behind. The stack is found by index, as it may have moved.
+	closeUpvalues(vm, vm->stack + stackCount);
+	vm->frameCount = vm->baseFrame;
+	vm->baseFrame = baseFrame;
+	vm->stackTop = vm->stack + stackCount;
+	vm->frame = &vm->frames[vm->frameCount - 1];
 
-	importingVm->imports[importingVm->importCount++] = vm;
+	// A failed import is run again the next time, rather than handing out what it exported so far.
+	if (result != STATUS_OK) tableDelete(&vm->loadedModules, key);
 
 	return result;
 }
 
 void freeVM(VM* vm) {
+	dumpGCStats(vm);
 
-	// Frees the VMs of the imports, as they are not freed in the import function
-	for (size_t i = 0; i < vm->importCount; i++) {
-		freeVM(vm->imports[i]);
+	for (size_t i = 0; i < vm->moduleCount; i++) {
+		freeModule(vm, vm->modules[i]);
 	}
 
 	freeTable(vm, &vm->strings);
-	freeTable(vm, &vm->globals);
+	freeTable(vm, &vm->builtins);
+	freeTable(vm, &vm->loadedModules);
+	freeTable(vm, &vm->stringMethods);
+	freeTable(vm, &vm->listMethods);
+	freeTable(vm, &vm->mapMethods);
+	freeTable(vm, &vm->arrayMethods);
 	freeObjects(vm);
-	free(vm->filename);
-	free(vm->grayStack);
-	free(vm->imports);
+	freeHeap(&vm->heap);
+	stopMarkHelpers(vm);
+	freeMarker(&vm->marker);
+	free(vm->remembered);
+	free(vm->youngObjects);
+	free(vm->modules);
 	free(vm->frames);
 	free(vm->stack);
-	if (vm->isImport) free(vm);
 }
\ No newline at end of file
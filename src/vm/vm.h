@@ -3,6 +3,8 @@
 #include <vm/chunk.h>
 #include <vm/table.h>
 #include <vm/object.h>
+#include <core/heap.h>
+#include <core/gcStats.h>
 
 typedef struct Compiler Compiler;
 
@@ -14,6 +16,24 @@ typedef enum {
 	STATUS_RUNTIME_ERR
 } InterpreterResult;
 
+typedef enum {
+	GC_IDLE,
+	GC_MARKING,
+	GC_SWEEPING
+} GCPhase;
+
+// The state of one thread tracing the heap. The VM's own marker is used whenever marking is serial.
+typedef struct {
+	VM* vm;
+	size_t grayCount;
+	size_t grayCapacity;
+	Obj** grayStack;
+	size_t viewCount;
+	size_t viewCapacity;
+	ObjString** views; // String views blackened by this marker.
+	struct MarkPool* pool; // Shared with the other markers while tracing in parallel, otherwise NULL.
+} Marker;
+
 typedef struct {
 	ObjClosure* closure;
 	uint8_t* ip;
@@ -22,6 +42,16 @@ typedef struct {
 	uint8_t* catchJump;
 } CallFrame;
 
+// The environment of one source file. Every module shares the VM's heap, stack and builtins, and lives
+// as long as it does, as the module's functions may still be called after its import finishes.
+struct Module {
+	Table globals;
+	Table imports; // Import paths already resolved from this file, to the exports of their modules.
+	ObjInstance* exports; // Filled in as the module runs, and shared by every file importing it.
+	ObjString* filepath; // The directory imports in this file are resolved against.
+	char* filename;
+};
+
 struct VM {
 	Compiler* compiler;
 	CallFrame* frames;
@@ -31,30 +61,50 @@ struct VM {
 	Value* stack;
 	size_t stackSize;
 	Value* stackTop;
-	Obj* objects;
+	Heap heap; // Holds the objects, their arrays and tables are still malloced.
+	size_t youngCount;
+	size_t youngCapacity;
+	Obj** youngObjects; // Allocated since the last collection. Old objects are only found through the heap.
+	HeapPage* unsweptPages; // The next page the current full collection has to sweep.
+	double sweepRate; // Pages swept each step, often less than one.
+	double sweepCredit; // Pages the sweep has been paced for but not yet swept.
 	Table strings;
-	Table globals;
-	Table exports;
+	Table builtins; // Copied into the globals of each new module.
 	Table stringMethods;
 	Table listMethods;
+	Table mapMethods;
+	Table arrayMethods;
 	ObjClass* objectClass;
 	ObjClass* importClass;
 	ObjClass* iteratorClass;
 	ObjClass* exceptionClass;
 	ObjUpvalue* openUpvalues;
-	size_t grayCount;
-	size_t grayCapacity;
-	Obj** grayStack;
+	Marker marker;
+	struct MarkPool* markPool; // Helper threads for parallel marking, started by the first full collection.
+	size_t gcMarkThreads; // Helper threads which trace alongside the VM's own. 0 marks serially.
+	size_t rememberedCount;
+	size_t rememberedCapacity;
+	Obj** remembered; // Old objects which may reference young ones.
 	size_t bytesAllocated;
 	size_t nextGC;
+	size_t nextMinorGC;
+	size_t nextGCStep;
+	size_t gcPauseTarget; // Longest a slice of a full collection should run, in microseconds. 0 disables slicing.
+	double gcGrowFactor;
+	size_t gcMinHeap;
+	size_t gcMaxHeap; // 0 for no limit.
+	GCStats gcStats;
+	GCPhase gcPhase;
+	bool isCollecting;
+	bool isCollectingYoung; // Old objects are not traced, and count as live, during minor collections.
+	bool shouldCompact; // Set when the heap is fragmented enough to compact at the next safe point.
 	ObjString* basePath;
-	ObjString* filepath;
-	char* filename;
-	size_t importCount;
-	size_t importCapacity;
-	struct VM** imports;
-	bool isImport;
-	struct VM* parent;
+	Module* module; // The module being compiled, and the one running outside of any call.
+	size_t moduleCount;
+	size_t moduleCapacity;
+	Module** modules;
+	Table loadedModules; // The canonical path of each imported file, to its module's exports.
+	size_t baseFrame; // Frames below this belong to the importer of the module being run.
 };
 
 void initVM(VM* vm, char* name);